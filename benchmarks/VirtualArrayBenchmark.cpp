@@ -0,0 +1,56 @@
+#include "ECS/VirtualArray.h"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+// Growing a dense pool's storage one component at a time: VirtualArray
+// commits pages in place, std::vector reallocates and moves everything it
+// holds each time it runs out. Run with: meson test -C build --benchmark
+
+namespace {
+
+// the size of a transform-like component
+struct Element {
+	float x, y, rotation, scale;
+};
+
+const size_t ELEMENTS = 4 * 1024 * 1024;
+const int RUNS = 5;
+
+template <typename Array>
+double GrowMilliseconds(Array& array) {
+	const auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < ELEMENTS; i++) {
+		array.push_back(Element{ static_cast<float>(i), 0.0f, 0.0f, 1.0f });
+	}
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// best of RUNS, each into a fresh array
+template <typename MakeArray>
+double BestMilliseconds(MakeArray makeArray) {
+	double best = 0.0;
+	for (int run = 0; run < RUNS; run++) {
+		auto array = makeArray();
+		const auto milliseconds = GrowMilliseconds(array);
+		if (run == 0 || milliseconds < best) {
+			best = milliseconds;
+		}
+	}
+	return best;
+}
+
+}
+
+int main() {
+	const auto vectorMilliseconds = BestMilliseconds([] { return std::vector<Element>(); });
+	const auto virtualMilliseconds = BestMilliseconds([] { return VirtualArray<Element>(ELEMENTS); });
+	const auto hugePageMilliseconds = BestMilliseconds([] { return VirtualArray<Element>(ELEMENTS, true); });
+
+	std::printf("growing to %zu elements of %zu bytes, best of %d\n", ELEMENTS, sizeof(Element), RUNS);
+	std::printf("  std::vector               %8.2f ms\n", vectorMilliseconds);
+	std::printf("  VirtualArray              %8.2f ms\n", virtualMilliseconds);
+	std::printf("  VirtualArray, huge pages  %8.2f ms\n", hugePageMilliseconds);
+	return 0;
+}
@@ -3,6 +3,8 @@
 
 #include <glm/glm.hpp>
 
+#include "ECS/ComponentTraits.h"
+
 struct TransformComponent {
 	glm::vec2 position;
 	glm::vec2 scale;
@@ -19,4 +21,9 @@ struct TransformComponent {
 	}
 };
 
-#endif
\ No newline at end of file
+template <>
+struct ComponentTraits<TransformComponent>: DefaultComponentTraits {
+	static constexpr bool doubleBuffered = true;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef COMPONENTTRAITS_H
+#define COMPONENTTRAITS_H
+
+#include <cstddef>
+
+// How the components of one type are stored, see ECS/Pool.h
+enum class StoragePolicy {
+	// Packed array, for components the systems walk every frame. The only
+	// storage groups can own.
+	Dense,
+	// Hash map, for rare components, keeps cold data out of the hot arrays
+	Sparse,
+	// Pages indexed by entity id, stable addresses and no indirection
+	Paged,
+	// At most one entity has it
+	Singleton
+};
+
+struct DefaultComponentTraits {
+	// Keep a published copy of the pool as of the last Registry::SwapBuffers,
+	// which copies the whole pool on the calling thread every time; nothing
+	// runs in parallel with it. Only worth it when readers need the previous
+	// values, as the renderer does with transforms to interpolate. Dense
+	// storage only.
+	static constexpr bool doubleBuffered = false;
+	static constexpr StoragePolicy storage = StoragePolicy::Dense;
+	// Dense storage only: when non-zero the pool reserves address space for
+	// this many components up front and commits pages as it grows, so
+	// references to components survive growth
+	static constexpr size_t reservedCapacity = 0;
+	// Ask for transparent huge pages on that range, for large pools
+	static constexpr bool hugePages = false;
+};
+
+/**
+ * ComponentTraits
+ * Per component type storage options. Specialize next to the component and
+ * override what differs from the defaults:
+ *
+ *   template <>
+ *   struct ComponentTraits<SpawnInfoComponent>: DefaultComponentTraits {
+ *       static constexpr StoragePolicy storage = StoragePolicy::Sparse;
+ *   };
+ */
+template <typename T>
+struct ComponentTraits: DefaultComponentTraits {};
+
+#endif
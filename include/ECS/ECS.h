@@ -2,17 +2,35 @@
 #define ECS_H
 
 #include <memory>
-#include <set>
+#include <algorithm>
+#include <iterator>
+#include <tuple>
 #include <bitset>
 #include <typeinfo>
 #include <utility>
 #include <vector>
 #include <typeindex>
+#include <type_traits>
 #include <unordered_map>
+#include <functional>
+#include <string>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "ECS/ComponentTraits.h"
+#include "ECS/EntityIdAllocator.h"
+#include "ECS/Pool.h"
+#include "ECS/RuntimePool.h"
+#include "Logger/BinaryLog.h"
 #include "Logger/Logger.h"
+#include "Profiler/Profiler.h"
 
 const unsigned int MAX_COMPONENTS = 32;
+// Work Registry::Compact hands a pool at a time, in slots moved or dropped;
+// the time budget is checked between steps
+const size_t COMPACTION_STEP_SLOTS = 4096;
 
 /// <summary>
 /// Signature 
@@ -21,6 +39,21 @@ const unsigned int MAX_COMPONENTS = 32;
 /// </summary>
 typedef std::bitset<MAX_COMPONENTS> Signature;
 
+// Calls func(componentId) for every component set in the signature, lowest
+// id first, skipping the clear bits
+template <typename TFunc>
+void ForEachComponent(const Signature& signature, TFunc&& func) {
+	for (auto bits = signature.to_ulong(); bits; bits &= bits - 1) {
+#ifdef _MSC_VER
+		unsigned long componentId;
+		_BitScanForward(&componentId, bits);
+		func(static_cast<int>(componentId));
+#else
+		func(__builtin_ctzl(bits));
+#endif
+	}
+}
+
 struct IComponent {
 protected:
 	static int nextId; 
@@ -37,24 +70,77 @@ public:
   	}
 };
 
+// Assigns ids to component types declared at runtime (see ECS/RuntimePool.h),
+// from the same sequence as Component<T>, so both kinds share signatures
+class RuntimeComponent: public IComponent {
+private:
+	static std::unordered_map<std::string, int> ids;
+
+public:
+	// The id of the named type, a new one the first time the name is seen
+	static int GetId(const std::string& name);
+	// -1 if no type has that name
+	static int FindId(const std::string& name);
+};
+
+// The low ENTITY_INDEX_BITS of a handle hold the entity id, the rest its generation
+const int ENTITY_INDEX_BITS = 24;
+const uint32_t ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+static_assert(MAX_ENTITIES <= (1 << ENTITY_INDEX_BITS), "entity ids must fit in a handle");
+
+/**
+ * EntityHandle
+ * What the registry and the systems store for an entity, 32 bits. The
+ * generation is bumped every time the id is recycled, so a handle kept past
+ * its entity's death no longer matches (Registry::IsAlive). It wraps after
+ * 256 reuses of one id.
+ */
+class EntityHandle {
+private:
+	uint32_t value = 0;
+
+public:
+	EntityHandle() = default;
+	EntityHandle(int id, uint8_t generation)
+		: value(static_cast<uint32_t>(id) | static_cast<uint32_t>(generation) << ENTITY_INDEX_BITS) {}
+
+	int GetId() const { return static_cast<int>(value & ENTITY_INDEX_MASK); }
+	uint8_t GetGeneration() const { return static_cast<uint8_t>(value >> ENTITY_INDEX_BITS); }
+
+	bool operator ==(const EntityHandle& other) const { return value == other.value; }
+	bool operator !=(const EntityHandle& other) const { return value != other.value; }
+	bool operator <(const EntityHandle& other) const { return value < other.value; }
+};
+
+static_assert(sizeof(EntityHandle) == 4, "entity handles are meant to be 32 bits");
+
+/**
+ * Entity
+ * Convenience facade for gameplay code, a handle plus the registry it lives
+ * in. Not meant to be stored in bulk, keep EntityHandles for that.
+ */
 class Entity {
 private:
-	int id;
+	EntityHandle handle;
 
 public:
-	Entity(int id) : id(id) {};
+	Entity(EntityHandle handle, class Registry* registry) : handle(handle), registry(registry) {};
 	Entity(const Entity& entity) = default; 
 	
 	int GetId() const;
+	EntityHandle GetHandle() const { return handle; }
+	void Kill();
 
 	Entity& operator =(const Entity& other) = default; 
-	bool operator ==(const Entity& other) const { return id == other.id; } 
-	bool operator !=(const Entity& other) const { return id != other.id; }
-	bool operator >(const Entity& other) const { return id > other.id; }
-	bool operator <(const Entity& other) const { return id < other.id; }
+	bool operator ==(const Entity& other) const { return handle == other.handle; } 
+	bool operator !=(const Entity& other) const { return handle != other.handle; }
+	bool operator >(const Entity& other) const { return other.handle < handle; }
+	bool operator <(const Entity& other) const { return handle < other.handle; }
 
 	template <typename TComponent, typename ...TArgs> void AddComponent(TArgs&& ...args);
+	template <typename ...TComponents, typename ...TArgs> void AddComponents(TArgs&& ...components);
 	template <typename TComponent> void RemoveComponent();
+	template <typename ...TComponents> void RemoveComponents();
 	template <typename TComponent> bool HasComponent() const; 
 	template <typename TComponent> TComponent& GetComponent() const;
 
@@ -72,59 +158,200 @@ public:
 class System {
 private:
 	Signature componentSignature; 
-	std::vector<Entity> entities; 
+	std::vector<EntityHandle> entities; 
+
+	friend class Registry;
+
+protected:
+	// Set by Registry::AddSystem, lets systems fetch their groups
+	class Registry* registry = nullptr;
 
 public:
 	System() = default; 
 	virtual ~System() = default; 
 	void AddEntityToSystem(Entity entity); 
 	void RemoveEntityFromSystem(Entity entity); 
-	std::vector<Entity> GetSystemEntities() const;
+	// Appends a batch of entities that share one signature
+	void AddEntitiesToSystem(const std::vector<EntityHandle>& batch);
+	// Drops every entity flagged in pendingKill (index = entity id) in one pass
+	void RemoveKilledEntities(const std::vector<bool>& pendingKill);
+	// Forgets every entity but keeps the storage
+	void ClearEntities();
+	void ReserveEntities(int count);
+	// Stable while the systems run: membership only changes in
+	// Registry::Update (and MoveEntities, which takes moved entities out). An
+	// entity that lost a required component since the last Update is still
+	// listed, check HasComponent where that can happen.
+	const std::vector<EntityHandle>& GetSystemEntities() const;
+	// Wraps a handle from GetSystemEntities for gameplay code
+	Entity GetEntity(EntityHandle handle) const;
 	const Signature& GetComponentSignature() const;
 
 	// Defines the component type entities must have to be considered by the system 
 	template <typename TComponent> void RequireComponent();
+	// Same for a runtime component type, by id
+	void RequireComponent(int componentId);
+};
+
+/**
+ * ECSStats
+ * Counters the registry keeps about its own housekeeping
+ */
+struct ECSStats {
+	// Registry::Compact
+	size_t compactionBytesReclaimed = 0;
+	double compactionMilliseconds = 0.0;
+	double lastCompactionMilliseconds = 0.0;
 };
 
 /**
- * Pool 
- * Just a vector (contigous data) of objects of Type T
+ * Group
+ * An owning group keeps every entity that has all of its components packed at
+ * the front of each owned pool, in the same order. Iterating a group is then a
+ * walk over parallel arrays with no sparse lookups or signature tests.
+ * A pool can only be owned by one group; observed components are required for
+ * membership but are read through the usual sparse lookup.
  */
-class IPool {
-public: 
-	virtual ~IPool() {}
+class Group {
+private:
+	// Components whose pools this group reorders
+	Signature ownedSignature;
+	// Owned and observed components an entity needs to be a member
+	Signature signature;
+	std::vector<SparseSet*> ownedPools;
+	// Members occupy [0, size) of every owned pool
+	size_t size = 0;
 
+public:
+	Group(const Signature& ownedSignature, const Signature& signature, std::vector<SparseSet*> ownedPools);
+
+	const Signature& GetSignature() const { return signature; }
+	const Signature& GetOwnedSignature() const { return ownedSignature; }
+	size_t GetSize() const { return size; }
+	bool Contains(int entityId) const;
+	// The owned pools are being cleared, nobody is left in the group
+	void Clear() { size = 0; }
+
+	// Called after a component was added to the entity
+	void OnComponentAdded(int entityId, const Signature& entitySignature);
+	// Called before a component is removed from the entity
+	void OnComponentRemoved(int entityId);
 };
 
-template <typename T>
-class Pool: public IPool {
+// Tags used to spell out a group: GetGroup<Owned<A, B>, Observed<C>>()
+template <typename ...TComponents> struct Owned {};
+template <typename ...TComponents> struct Observed {};
+
+/**
+ * GroupView
+ * Typed handle to a group, cheap to copy. Owned components are exposed as
+ * raw arrays indexed [0, Size()).
+ */
+template <typename TOwned, typename TObserved = Observed<>> class GroupView;
 
+template <typename ...TOwned, typename ...TObserved>
+class GroupView<Owned<TOwned...>, Observed<TObserved...>> {
 private:
-	std::vector<T> data;
+	Group* group;
+	std::tuple<Pool<TOwned>*...> ownedPools;
+	std::tuple<PoolFor<TObserved>*...> observedPools;
 
 public:
-	Pool(int size = 100) {
-		data.resize(size); 
+	GroupView(Group* group, Pool<TOwned>* ...owned, PoolFor<TObserved>* ...observed)
+		: group(group), ownedPools(owned...), observedPools(observed...) {}
+
+	size_t Size() const { return group->GetSize(); }
+
+	template <typename TComponent> TComponent* Data() const {
+		return std::get<Pool<TComponent>*>(ownedPools)->Data();
 	}
-	virtual ~Pool() = default; 
 
-	bool isEmpty() const  { return data.empty(); }
+	const int* Entities() const {
+		return std::get<0>(ownedPools)->Entities();
+	}
 
-	size_t GetSize() const { return data.size(); }
+	// Calls func(owned..., observed...) for every member
+	template <typename TFunc> void Each(TFunc&& func) const {
+		const auto count = Size();
+		const int* entities = Entities();
+		const auto owned = std::make_tuple(std::get<Pool<TOwned>*>(ownedPools)->Data()...);
+		for (size_t i = 0; i < count; i++) {
+			func(std::get<TOwned*>(owned)[i]...,
+				 std::get<PoolFor<TObserved>*>(observedPools)->Get(entities[i])...);
+		}
+	}
 
-	void Resize(int n) { data.resize(n); }
+	// Like Each, but hands out const references to the published frame of
+	// double buffered components, for readers such as the renderer
+	template <typename TFunc> void EachPublished(TFunc&& func) const {
+		const auto count = Size();
+		const int* entities = Entities();
+		const auto owned = std::make_tuple(std::get<Pool<TOwned>*>(ownedPools)->PublishedData()...);
+		for (size_t i = 0; i < count; i++) {
+			func(std::get<const TOwned*>(owned)[i]...,
+				 std::get<PoolFor<TObserved>*>(observedPools)->GetPublished(entities[i])...);
+		}
+	}
 
-	void Clear() { data.clear(); }
+	// func(current..., published...): every component of the member as it is
+	// now, then as of the last SwapBuffers. Swapping before each simulation
+	// step makes the published values the previous step, for interpolation.
+	template <typename TFunc> void EachWithPublished(TFunc&& func) const {
+		const auto count = Size();
+		const int* entities = Entities();
+		const auto owned = std::make_tuple(static_cast<const TOwned*>(std::get<Pool<TOwned>*>(ownedPools)->Data())...);
+		const auto published = std::make_tuple(std::get<Pool<TOwned>*>(ownedPools)->PublishedData()...);
+		for (size_t i = 0; i < count; i++) {
+			func(std::get<const TOwned*>(owned)[i]...,
+				 static_cast<const TObserved&>(std::get<PoolFor<TObserved>*>(observedPools)->Get(entities[i]))...,
+				 std::get<const TOwned*>(published)[i]...,
+				 std::get<PoolFor<TObserved>*>(observedPools)->GetPublished(entities[i])...);
+		}
+	}
+};
 
-	void Add(T object) { data.push_back(object); }
+enum class ComponentEvent { Construct, Update, Destroy };
 
-	void Set(int index, T object) { data[index] = object; }
+/**
+ * Observer
+ * Collects the ids of entities whose component was constructed, updated or
+ * destroyed. Nothing is called back from inside AddComponent/RemoveComponent:
+ * the registry hands each non-empty batch to the handler once per Update.
+ * An entity can appear more than once in a batch if it changed more than once.
+ */
+class Observer {
+private:
+	int componentId;
+	std::function<void(const Observer&)> handler;
 
-	T& Get(int index) { return static_cast<T&>(data[index]); }
+	// events recorded since the last delivery
+	std::vector<int> pendingConstructed;
+	std::vector<int> pendingUpdated;
+	std::vector<int> pendingDestroyed;
 
-	T& operator [](unsigned int index) { return data[index]; }
+	// batch currently handed to the handler, events raised while it runs
+	// go to the pending buffers and wait for the next Update
+	std::vector<int> constructed;
+	std::vector<int> updated;
+	std::vector<int> destroyed;
 
-}; 
+	// set by RemoveObserver, no more events or batches after that
+	bool removed = false;
+
+	friend class Registry;
+	void Push(ComponentEvent event, int entityId);
+	void Deliver();
+	void Discard();
+
+public:
+	Observer(int componentId, std::function<void(const Observer&)> handler)
+		: componentId(componentId), handler(std::move(handler)) {}
+
+	int GetComponentId() const { return componentId; }
+	const std::vector<int>& GetConstructed() const { return constructed; }
+	const std::vector<int>& GetUpdated() const { return updated; }
+	const std::vector<int>& GetDestroyed() const { return destroyed; }
+};
 
 /**
  * Registry
@@ -134,52 +361,211 @@ public:
 class Registry {
 
 private:
-	// Keep track of how many entities were added to the scene
-	int numEntities = 0; 
+	// Hands out entity ids, safe to use from any thread
+	EntityIdAllocator entityIds;
 
 	// Vector of component pools, contains all the data for a certain component type
 	// vector index = component type id 
 	// Pool index = entity id. 
 	std::vector<std::shared_ptr<IPool>> componentPools;
-
-	// set of Entities that are flagged to be added or removed in the next Update
-	std::set<Entity> entitiesToBeAdded;  
-	std::set<Entity> entitiesToBeKilled;  
+	// Component ids whose pool is a ByteColumnPool, set by AddPool
+	Signature runtimeComponents;
+
+	// Entities flagged to be added or removed in the next Update. Additions are
+	// pushed lock-free by CreateEntity and drained into stagedEntities; kills
+	// are deduplicated through entitiesPendingKill (index = entity id).
+	// The vectors keep their capacity from frame to frame.
+	ConcurrentIdStack entitiesToBeAdded;
+	std::vector<int> stagedEntities;
+	std::vector<int> entitiesToBeKilled;
+	std::vector<bool> entitiesPendingKill;
+	// Entities handed to the systems by Update (index = entity id), their
+	// memberships follow later signature changes at the next Update
+	std::vector<bool> entitiesInSystems;
+	// Entities in systems whose signature changed since the last Update, with
+	// the signature the systems last matched; deduplicated through
+	// entitiesPendingReconcile (index = entity id)
+	std::vector<std::pair<int, Signature>> entitiesToReconcile;
+	std::vector<bool> entitiesPendingReconcile;
+	// scratch buffer for handing same-signature runs to the systems
+	std::vector<EntityHandle> systemBatch;
+
+	// Generation of every id (index = entity id), bumped when it is recycled
+	PagedArray<uint8_t> entityGenerations;
 	
-	// Vector of component signatures, handles which component is turned "on"
-	// for [Vector index = entity id] 
-	std::vector<Signature> entityComponentSignatures;
+	// Component signatures, handles which component is turned "on"
+	// for [index = entity id]. Paged so it grows without moving.
+	PagedArray<Signature> entityComponentSignatures;
 
 	// map of systems from their respective type_index
 	std::unordered_map<std::type_index, std::shared_ptr<System>> systems; 
 
+	// next pool Compact looks at, it resumes where the last budget ran out
+	size_t compactionCursor = 0;
+	ECSStats stats;
+
+	// pools whose components are double buffered, see SwapBuffers
+	std::vector<IPool*> doubleBufferedPools;
+
+	// map of owning groups from the type_index of their Owned/Observed spelling
+	std::unordered_map<std::type_index, std::shared_ptr<Group>> groups;
+
+	// observers interested in a component, vector index = component type id
+	std::vector<std::vector<std::shared_ptr<Observer>>> componentObservers;
+	// While Update hands out batches RemoveObserver only marks the observer,
+	// erasing would shift the list under the delivery loop. The marked ones
+	// are erased once delivery is over.
+	bool deliveringObservers = false;
+	bool observersRemovedDuringDelivery = false;
+
+	template <typename TComponent> std::shared_ptr<PoolFor<TComponent>> GetOrCreatePool();
+	// False (logged) when TComponent is a singleton another entity owns
+	template <typename TComponent> bool CanAddComponent(int entityId);
+
+	void NotifyObservers(int componentId, ComponentEvent event, int entityId);
+
+	// Flags a live entity id for the next Update, duplicates are ignored
+	void FlagForKill(int entityId);
+
+	// Records that an entity already in the systems changed signature, before
+	// being the one the systems last matched. Nothing moves until Update, so
+	// a system may add or remove components of the entities it is iterating.
+	void QueueSystemChange(int entityId, const Signature& before);
+	// Update: adds or removes the queued entities from the systems whose
+	// interest changed between the recorded and the current signature
+	void ReconcileSystems();
+
+	// The bookkeeping around the pools of a batched add or remove: signature,
+	// groups, observers and systems. Removal is split because groups have to
+	// be left before the pools swap-and-pop.
+	void CommitAddedComponents(int entityId, const Signature& before, const Signature& added);
+	void BeginRemovingComponents(int entityId, const Signature& removed);
+	void CommitRemovedComponents(int entityId, const Signature& before, const Signature& removed);
+
+	// Killed entities that have a component, vector index = component type id.
+	// Reused every Update so each pool gets its dead entities in one call.
+	std::vector<std::vector<int>> killedEntitiesPerPool;
+
+	// Detaches every component of the killed entities, groups and observers
+	// included, pool by pool
+	void RemoveAllComponents(const std::vector<int>& entityIds);
+
+	// Matches one run of entities with identical signatures against the systems
+	void AddEntitiesToSystems(const int* entityIds, size_t count);
+
+	void AddPool(int componentId, std::shared_ptr<IPool> pool);
+
+	friend std::vector<Entity> MoveEntities(const std::vector<Entity>& batch, Registry& from, Registry& to);
+
+	template <typename ...TOwned, typename ...TObserved>
+	GroupView<Owned<TOwned...>, Observed<TObserved...>> MakeGroup(Owned<TOwned...>, Observed<TObserved...>);
+
 public:
-	Registry() {Logger::Log("Registry constructor called");
+	Registry() {LOG_INFO(ECS, "Registry constructor called");
 	} 
 
 	~Registry() {
-		Logger::Log("Registry destroyed");
+		LOG_INFO(ECS, "Registry destroyed");
 	}
 	void Update();
+
+	// Drops every entity and component for a level reload. Pools, systems,
+	// groups and observers stay registered and keep their capacity, so this
+	// does not touch the heap. Pending observer events are discarded, no
+	// destroy events are raised for the cleared entities.
+	void Clear();
+
+	// Sizes pools, systems and staging for entityCount entities so spawning a
+	// level does not grow anything
+	void Reserve(int entityCount);
+
+	// Incremental housekeeping: compacts pools round-robin until the time
+	// budget is spent, resuming inside a pool that was cut short. Pools with
+	// nothing to reclaim cost almost nothing. Pools keep at least the capacity
+	// given to Reserve. Reported in GetStats.
+	void Compact(double budgetMilliseconds);
+	const ECSStats& GetStats() const { return stats; }
+
+	// Bytes held by the component pools, capacity included
+	size_t MemoryUsage() const;
+
+	// Frame boundary for double buffered components: what the simulation wrote
+	// becomes the stable frame readers see until the next call. Copies every
+	// double buffered pool, O(n) in their total size; call it while no reader
+	// is active.
+	void SwapBuffers();
 	
 	// Entity management 
+	// Thread-safe: spawners may create entities from worker threads. Adding
+	// components still has to happen on the thread that owns the registry.
 	Entity CreateEntity();
+	// The facade for a handle, e.g. one taken from a system
+	Entity GetEntity(EntityHandle handle) { return Entity(handle, this); }
+	// The current handle of a live entity id, e.g. one from an observer or a pool
+	EntityHandle GetHandle(int entityId) const;
+	// False once the entity was killed and its id recycled
+	bool IsAlive(EntityHandle handle) const;
 	
 	// Component management
+	// Constructs the component once in its pool; a component the entity
+	// already has is destroyed and constructed again in place, so args must
+	// not refer to it. A singleton component another entity owns is refused
+	// (logged) and the entity is left as it was.
 	template <typename TComponent, typename ...TArgs> void AddComponent(Entity entity, TArgs&& ...args);  
 	template <typename TComponent> void RemoveComponent(Entity entity); 
+	// Several components in one go: AddComponents<A, B>(entity, A(...), B(...)).
+	// One argument per component, forwarded to its constructor. The signature
+	// changes once and groups and systems are updated once for the whole set.
+	// If any of them is a singleton owned elsewhere none is added.
+	template <typename ...TComponents, typename ...TArgs> void AddComponents(Entity entity, TArgs&& ...components);
+	template <typename ...TComponents> void RemoveComponents(Entity entity);
 	template <typename TComponent> bool HasComponent(Entity entity) const;
-	template <typename TComponent> TComponent& GetComponent(Entity entity) const; 
 
-	// TODO:
-	//void KillEntity(Entity entity);
-	//void AddEntityToSystem(Entity entity);
+	// Runtime component types, declared by scripts. Registering a layout
+	// creates its pool and returns the component id the calls below take.
+	// The fields start zeroed. Returns -1 (after logging) when there is no
+	// component id left.
+	int RegisterComponent(const ComponentLayout& layout);
+	// Whether componentId names a registered runtime type, check ids that
+	// come from scripts before passing them to the calls below
+	bool IsRuntimeComponent(int componentId) const;
+	ByteColumnPool& GetRuntimePool(int componentId) const;
+	// Ids that are not runtime types are logged and ignored
+	void AddComponent(Entity entity, int componentId);
+	void RemoveComponent(Entity entity, int componentId);
+	bool HasComponent(Entity entity, int componentId) const;
+	// Mixed query: func(entity, TComponents&...) for every entity that has the
+	// native TComponents and every runtime component in runtimeIds (read their
+	// fields through GetRuntimePool). Walks the smallest of the runtime pools
+	// backwards, so func may remove components; needs at least one runtime id,
+	// use a group or a system for native components alone.
+	template <typename ...TComponents, typename TFunc> void EachWith(const std::vector<int>& runtimeIds, TFunc&& func);
+	template <typename TComponent> TComponent& GetComponent(Entity entity) const; 
+	// Records an on-update event after the component was modified in place
+	template <typename TComponent> void MarkComponentUpdated(Entity entity);
+
+	// Observer management, handlers run in batches from Update, after the
+	// staged entities were handed to the systems. A handler may remove any
+	// observer, itself included; a removed observer gets no further batch.
+	template <typename TComponent> std::shared_ptr<Observer> AddObserver(std::function<void(const Observer&)> handler);
+	void RemoveObserver(const std::shared_ptr<Observer>& observer);
+
+	// Flags the entity to be destroyed in the next Update, its id is recycled.
+	// Stale handles are ignored.
+	void KillEntity(Entity entity);
 	
 	// System management
 	template <typename TSystem, typename ...TArgs> void AddSystem(TArgs&& ...args);
 	template<typename TSystem> void RemoveSystem();
 	template<typename TSystem> bool HasSystem() const; 
 	template<typename TSystem> TSystem& GetSystem() const;
+	// GetSystem<TSystem>().Update(args...) inside a profiler zone named after
+	// the system
+	template <typename TSystem, typename ...TArgs> void UpdateSystem(TArgs&& ...args) const;
+
+	// Group management, the group is built on first request and kept up to
+	// date as components are added and removed
+	template <typename TOwned, typename TObserved = Observed<>> GroupView<TOwned, TObserved> GetGroup();
 
 	// Checks the component signature of an entity and add the entity to the systems 
 	// that are interested in it
@@ -187,6 +573,17 @@ public:
 
 };
 
+/**
+ * Moves a batch of entities to another registry, e.g. across the boundary of
+ * two streamed map regions. Signatures and component data travel pool by pool
+ * (one virtual call per pool, none per entity). The entities get new ids in
+ * `to` and join its systems on its next Update; in `from` they leave the
+ * systems at once and their ids are recycled on its next Update.
+ * Returns the new handles, in batch order. Stale handles and entities already
+ * killed or listed twice are skipped, so the result can be shorter than batch.
+ */
+std::vector<Entity> MoveEntities(const std::vector<Entity>& batch, Registry& from, Registry& to);
+
 template <typename TComponent>
 void System::RequireComponent() {
 	const auto componentId = Component<TComponent>::GetId(); 
@@ -196,6 +593,7 @@ void System::RequireComponent() {
 template <typename TSystem, typename ...TArgs> 
 void Registry::AddSystem(TArgs&& ...args) {
 	std::shared_ptr<TSystem> newSystem = std::make_shared<TSystem>(std::forward<TArgs>(args)...); 
+	newSystem->registry = this;
 	systems.insert(std::make_pair(std::type_index(typeid(TSystem)), newSystem));
 }
 
@@ -215,35 +613,73 @@ TSystem& Registry::GetSystem() const {
 	return *(std::static_pointer_cast<TSystem>(system->second));
 }
 
-template <typename TComponent, typename ...TArgs>
-void Registry::AddComponent(Entity entity, TArgs && ...args) {
+template <typename TSystem, typename ...TArgs>
+void Registry::UpdateSystem(TArgs&& ...args) const {
+#if PROFILER_ENABLED
+	static const char* const zoneName = Profiler::InternName(typeid(TSystem));
+	PROFILE_ZONE(zoneName);
+#endif
+	GetSystem<TSystem>().Update(std::forward<TArgs>(args)...);
+}
 
+template <typename TComponent>
+std::shared_ptr<PoolFor<TComponent>> Registry::GetOrCreatePool() {
 	const auto componentId = Component<TComponent>::GetId(); 
-	const auto entityId = entity.GetId();
 
 	// ids represent the current numOfComponents in the current pool;
-	if (componentId >= componentPools.size()){
+	if (componentId >= static_cast<int>(componentPools.size())){
 		componentPools.resize(componentId + 1, nullptr);
 	}
 
 	// if we don't have a component pool for this component. make it
-	if (!componentPools[componentId]) { 
-		std::shared_ptr<Pool<TComponent>> newComponentPool = std::make_shared<Pool<TComponent>>(); 
-		componentPools[componentId] = newComponentPool;
+	if (!componentPools[componentId]) {
+		AddPool(componentId, std::make_shared<PoolFor<TComponent>>());
 	}
 
- 	std::shared_ptr<Pool<TComponent>> componentPool = std::static_pointer_cast<Pool<TComponent>>(componentPools[componentId]);
+	return std::static_pointer_cast<PoolFor<TComponent>>(componentPools[componentId]);
+}
 
-	if(entityId >= static_cast<int>(componentPool->GetSize())) {
-		componentPool->Resize(numEntities); 
-	} 
+template <typename TComponent>
+bool Registry::CanAddComponent(int entityId) {
+	if constexpr (ComponentTraits<TComponent>::storage == StoragePolicy::Singleton) {
+		if (!GetOrCreatePool<TComponent>()->CanAdd(entityId)) {
+			LOG_ERROR(ECS, "Singleton component id " + std::to_string(Component<TComponent>::GetId()) + 
+				" is already on another entity, not added to entity id " + std::to_string(entityId));
+			return false;
+		}
+	}
+	return true;
+}
+
+template <typename TComponent, typename ...TArgs>
+void Registry::AddComponent(Entity entity, TArgs && ...args) {
 
-	TComponent newComponent(std::forward<TArgs>(args)...);
-	componentPool->Set(entityId, newComponent); 
+	const auto componentId = Component<TComponent>::GetId(); 
+	const auto entityId = entity.GetId();
+
+	if (!CanAddComponent<TComponent>(entityId)) {
+		return;
+	}
 
+ 	std::shared_ptr<PoolFor<TComponent>> componentPool = GetOrCreatePool<TComponent>();
+
+	const bool isUpdate = componentPool->Contains(entityId);
+
+	componentPool->Emplace(entityId, std::forward<TArgs>(args)...); 
+
+	const auto before = entityComponentSignatures[entityId];
 	entityComponentSignatures[entityId].set(componentId); 
+	QueueSystemChange(entityId, before);
+
+	for (auto& group: groups) {
+		if (group.second->GetSignature().test(componentId)) {
+			group.second->OnComponentAdded(entityId, entityComponentSignatures[entityId]);
+		}
+	}
 
-	Logger::Log("Component Id = " + std::to_string(componentId) + " was added to entity id " + std::to_string(entityId));
+	NotifyObservers(componentId, isUpdate ? ComponentEvent::Update : ComponentEvent::Construct, entityId);
+
+	LOG_EVENT(LOG_LEVEL_DEBUG, ECS, "Component Id = {} was added to entity id {}", componentId, entityId);
 }
 
 template <typename TComponent> 
@@ -251,11 +687,124 @@ void Registry::RemoveComponent(Entity entity) {
 	const auto componentId = Component<TComponent>::GetId();
 	const auto entityId = entity.GetId();
 
+	if (!HasComponent<TComponent>(entity)) {
+		return;
+	}
+
+	// leave the groups first so the swap-and-pop below never lands inside a group
+	for (auto& group: groups) {
+		if (group.second->GetSignature().test(componentId)) {
+			group.second->OnComponentRemoved(entityId);
+		}
+	}
+
+	NotifyObservers(componentId, ComponentEvent::Destroy, entityId);
+
+	std::static_pointer_cast<PoolFor<TComponent>>(componentPools[componentId])->Remove(entityId);
+
+	const auto before = entityComponentSignatures[entityId];
 	entityComponentSignatures[entityId].set(componentId, false);
-	Logger::Log("Component Id = " + std::to_string(componentId) + " was removed from entity id " + std::to_string(entityId));
+	QueueSystemChange(entityId, before);
+	LOG_EVENT(LOG_LEVEL_DEBUG, ECS, "Component Id = {} was removed from entity id {}", componentId, entityId);
 
 }
 
+template <typename ...TComponents, typename ...TArgs>
+void Registry::AddComponents(Entity entity, TArgs&& ...components) {
+	static_assert(sizeof...(TComponents) == sizeof...(TArgs), "AddComponents takes one argument per component");
+	const auto entityId = entity.GetId();
+
+	if (!(CanAddComponent<TComponents>(entityId) && ...)) {
+		return;
+	}
+
+	Signature added;
+	(added.set(Component<TComponents>::GetId()), ...);
+
+	const auto before = entityComponentSignatures[entityId];
+	(GetOrCreatePool<TComponents>()->Emplace(entityId, std::forward<TArgs>(components)), ...);
+	CommitAddedComponents(entityId, before, added);
+
+	LOG_EVENT(LOG_LEVEL_DEBUG, ECS, "{} components were added to entity id {}", sizeof...(TComponents), entityId);
+}
+
+template <typename ...TComponents>
+void Registry::RemoveComponents(Entity entity) {
+	const auto entityId = entity.GetId();
+
+	Signature removed;
+	(removed.set(Component<TComponents>::GetId()), ...);
+
+	const auto before = entityComponentSignatures[entityId];
+	removed &= before;
+	if (removed.none()) {
+		return;
+	}
+
+	// leave the groups first so the swap-and-pop below never lands inside a group
+	BeginRemovingComponents(entityId, removed);
+
+	((removed.test(Component<TComponents>::GetId()) ? GetOrCreatePool<TComponents>()->Remove(entityId) : void()), ...);
+
+	CommitRemovedComponents(entityId, before, removed);
+
+	LOG_EVENT(LOG_LEVEL_DEBUG, ECS, "{} components were removed from entity id {}", removed.count(), entityId);
+}
+
+template <typename TComponent>
+void Registry::MarkComponentUpdated(Entity entity) {
+	NotifyObservers(Component<TComponent>::GetId(), ComponentEvent::Update, entity.GetId());
+}
+
+template <typename TComponent>
+std::shared_ptr<Observer> Registry::AddObserver(std::function<void(const Observer&)> handler) {
+	const auto componentId = Component<TComponent>::GetId();
+
+	if (componentId >= static_cast<int>(componentObservers.size())) {
+		componentObservers.resize(componentId + 1);
+	}
+
+	std::shared_ptr<Observer> observer = std::make_shared<Observer>(componentId, std::move(handler));
+	componentObservers[componentId].push_back(observer);
+	return observer;
+}
+
+template <typename TOwned, typename TObserved>
+GroupView<TOwned, TObserved> Registry::GetGroup() {
+	return MakeGroup(TOwned{}, TObserved{});
+}
+
+template <typename ...TOwned, typename ...TObserved>
+GroupView<Owned<TOwned...>, Observed<TObserved...>> Registry::MakeGroup(Owned<TOwned...>, Observed<TObserved...>) {
+	static_assert(sizeof...(TOwned) > 0, "A group must own at least one component");
+	static_assert((std::is_same<PoolFor<TOwned>, Pool<TOwned>>::value && ...), "A group can only own components with dense storage");
+	using TView = GroupView<Owned<TOwned...>, Observed<TObserved...>>;
+
+	const auto key = std::type_index(typeid(TView));
+	auto group = groups.find(key);
+
+	if (group == groups.end()) {
+		Signature ownedSignature;
+		(ownedSignature.set(Component<TOwned>::GetId()), ...);
+		Signature signature = ownedSignature;
+		(signature.set(Component<TObserved>::GetId()), ...);
+
+		std::vector<SparseSet*> ownedPools = { GetOrCreatePool<TOwned>().get()... };
+		std::shared_ptr<Group> newGroup = std::make_shared<Group>(ownedSignature, signature, ownedPools);
+
+		// Pull in the entities that already have every component. Members are
+		// swapped to the front, behind the cursor, so the walk stays valid.
+		SparseSet* pool = ownedPools[0];
+		for (size_t i = 0; i < pool->GetSize(); i++) {
+			const auto entityId = pool->EntityAt(static_cast<int>(i));
+			newGroup->OnComponentAdded(entityId, entityComponentSignatures[entityId]);
+		}
+
+		group = groups.insert(std::make_pair(key, newGroup)).first;
+	}
+
+	return TView(group->second.get(), GetOrCreatePool<TOwned>().get()..., GetOrCreatePool<TObserved>().get()...);
+}
 
 template <typename TComponent> 
 bool Registry::HasComponent(Entity entity) const{
@@ -265,12 +814,46 @@ bool Registry::HasComponent(Entity entity) const{
 	return entityComponentSignatures[entityId].test(componentId); 
 }
 
+template <typename ...TComponents, typename TFunc>
+void Registry::EachWith(const std::vector<int>& runtimeIds, TFunc&& func) {
+	Signature signature;
+	(signature.set(Component<TComponents>::GetId()), ...);
+	ByteColumnPool* smallest = nullptr;
+	for (auto componentId: runtimeIds) {
+		if (!IsRuntimeComponent(componentId)) {
+			LOG_ERROR(ECS, "EachWith: " + std::to_string(componentId) + " is not a runtime component id");
+			return;
+		}
+		signature.set(componentId);
+		auto& pool = GetRuntimePool(componentId);
+		if (!smallest || pool.GetSize() < smallest->GetSize()) {
+			smallest = &pool;
+		}
+	}
+	if (!smallest) {
+		LOG_ERROR(ECS, "EachWith needs at least one runtime component id");
+		return;
+	}
+
+	for (auto i = smallest->GetSize(); i-- > 0;) {
+		// func removed more than one component
+		if (i >= smallest->GetSize()) {
+			continue;
+		}
+		const auto entityId = smallest->EntityAt(static_cast<int>(i));
+		if ((entityComponentSignatures[entityId] & signature) != signature) {
+			continue;
+		}
+		const auto entity = GetEntity(GetHandle(entityId));
+		func(entity, GetComponent<TComponents>(entity)...);
+	}
+}
 
 template <typename TComponent>
 TComponent& Registry::GetComponent(Entity entity) const {
 	const auto componentId = Component<TComponent>::GetId(); 
 	const auto entityId = entity.GetId(); 
-	auto componentPool = std::static_pointer_cast<Pool<TComponent>>(componentPools[componentId]);
+	auto componentPool = std::static_pointer_cast<PoolFor<TComponent>>(componentPools[componentId]);
 	return componentPool->Get(entityId); 
 }
 
@@ -280,11 +863,21 @@ void Entity::AddComponent(TArgs&& ...args) {
 	registry->AddComponent<TComponent>(*this, std::forward<TArgs>(args)...);
 }
 
+template <typename ...TComponents, typename ...TArgs>
+void Entity::AddComponents(TArgs&& ...components) {
+	registry->AddComponents<TComponents...>(*this, std::forward<TArgs>(components)...);
+}
+
 template <typename TComponent>
 void Entity::RemoveComponent() {
 	registry->RemoveComponent<TComponent>(*this);
 }	
 
+template <typename ...TComponents>
+void Entity::RemoveComponents() {
+	registry->RemoveComponents<TComponents...>(*this);
+}
+
 template <typename TComponent>
 bool Entity::HasComponent() const {
 	return registry->HasComponent<TComponent>(*this);
@@ -0,0 +1,120 @@
+#ifndef ENTITYIDALLOCATOR_H
+#define ENTITYIDALLOCATOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Entity ids live in [0, MAX_ENTITIES)
+const int ENTITY_PAGE_BITS = 12;
+const int ENTITY_PAGE_SIZE = 1 << ENTITY_PAGE_BITS;
+const int MAX_ENTITY_PAGES = 4096;
+const int MAX_ENTITIES = ENTITY_PAGE_SIZE * MAX_ENTITY_PAGES;
+
+/**
+ * PagedArray
+ * Array indexed by entity id, made of fixed size pages that are allocated on
+ * demand and never move. Growing it does not invalidate references held by
+ * other threads, so readers need no lock. EnsurePage may be called from any
+ * thread; operator[] requires the page to exist.
+ */
+template <typename T>
+class PagedArray {
+private:
+	std::unique_ptr<std::atomic<T*>[]> pages;
+
+public:
+	PagedArray() : pages(new std::atomic<T*>[MAX_ENTITY_PAGES]()) {}
+	~PagedArray() {
+		for (int i = 0; i < MAX_ENTITY_PAGES; i++) {
+			delete[] pages[i].load(std::memory_order_relaxed);
+		}
+	}
+	PagedArray(const PagedArray&) = delete;
+	PagedArray& operator =(const PagedArray&) = delete;
+
+	void EnsurePage(int index) {
+		auto& slot = pages[index >> ENTITY_PAGE_BITS];
+		if (slot.load(std::memory_order_acquire)) {
+			return;
+		}
+		T* page = new T[ENTITY_PAGE_SIZE]();
+		T* expected = nullptr;
+		// another thread may have won the race, keep theirs
+		if (!slot.compare_exchange_strong(expected, page, std::memory_order_acq_rel)) {
+			delete[] page;
+		}
+	}
+
+	// Allocates the pages covering [0, count) up front
+	void Reserve(int count) {
+		for (int index = 0; index < count; index += ENTITY_PAGE_SIZE) {
+			EnsurePage(index);
+		}
+	}
+
+	T& operator [](int index) const {
+		return pages[index >> ENTITY_PAGE_BITS].load(std::memory_order_acquire)[index & (ENTITY_PAGE_SIZE - 1)];
+	}
+};
+
+/**
+ * ConcurrentIdStack
+ * Lock-free intrusive stack of entity ids (Treiber stack). The links are
+ * stored per id, so pushing never allocates once a page exists. The head packs
+ * a tag next to the top id, bumped on every pop, to rule out ABA.
+ */
+class ConcurrentIdStack {
+private:
+	// low 32 bits: top id + 1 (0 means empty), high 32 bits: tag
+	std::atomic<uint64_t> head{0};
+	PagedArray<std::atomic<int>> next;
+
+public:
+	void Push(int id);
+	// Returns -1 when the stack is empty
+	int Pop();
+	// Detaches the whole stack at once and appends it to ids, most recent first
+	void TakeAll(std::vector<int>& ids);
+	// Forgets every id, keeping the link pages
+	void Clear();
+	void Reserve(int count) { next.Reserve(count); }
+};
+
+/**
+ * EntityIdAllocator
+ * Hands out entity ids from any thread without a lock. Recycled ids come from
+ * a concurrent free list; otherwise each thread reserves a range of ids with a
+ * single atomic add and serves allocations from it locally.
+ */
+class EntityIdAllocator {
+private:
+	// distinguishes allocators in the per-thread range cache
+	const uint64_t instanceId;
+	// bumped by Reset so ranges cached before it are discarded
+	std::atomic<uint32_t> epoch{0};
+	std::atomic<int> nextId{0};
+	ConcurrentIdStack freeIds;
+
+public:
+	// ids reserved per thread at a time
+	static const int RANGE_SIZE = 64;
+
+	EntityIdAllocator();
+	EntityIdAllocator(const EntityIdAllocator&) = delete;
+	EntityIdAllocator& operator =(const EntityIdAllocator&) = delete;
+
+	int Allocate();
+	void Release(int id);
+
+	// Makes every id available again, starting from 0. Must not overlap with
+	// Allocate or Release on other threads.
+	void Reset();
+	void Reserve(int count) { freeIds.Reserve(count); }
+
+	// Every id handed out so far is below this bound
+	int GetHighWaterMark() const { return nextId.load(std::memory_order_acquire); }
+};
+
+#endif
@@ -0,0 +1,670 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <algorithm>
+#include <bitset>
+#include <cassert>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ECS/ComponentTraits.h"
+#include "ECS/VirtualArray.h"
+#include "Logger/Logger.h"
+
+// Reallocates vector with room for exactly capacity elements (never below its
+// size), returns the bytes given back
+template <typename T>
+size_t ShrinkCapacity(std::vector<T>& vector, size_t capacity) {
+	capacity = std::max(capacity, vector.size());
+	if (vector.capacity() <= capacity) {
+		return 0;
+	}
+	const auto before = vector.capacity();
+	std::vector<T> shrunk;
+	shrunk.reserve(capacity);
+	std::move(vector.begin(), vector.end(), std::back_inserter(shrunk));
+	vector.swap(shrunk);
+	return (before - vector.capacity()) * sizeof(T);
+}
+
+template <typename T>
+size_t ShrinkCapacity(VirtualArray<T>& array, size_t capacity) {
+	return array.Decommit(capacity);
+}
+
+// One step of an incremental Compact: shrinks array to capacity when it holds
+// more than half again as much, so a pool hovering around its peak is not
+// reallocated on every pass. Charged the slots it keeps (slotSize bytes each
+// for byte columns). A reallocation cannot be split, so it runs whenever any
+// budget is left and may overdraw it. Returns false while array still needs
+// shrinking.
+template <typename Array>
+bool ShrinkStep(Array& array, size_t capacity, size_t& slotBudget, size_t& reclaimed, size_t slotSize = 1) {
+	if (array.capacity() <= capacity + capacity / 2) {
+		return true;
+	}
+	if (slotBudget == 0) {
+		return false;
+	}
+	slotBudget -= std::min(slotBudget, array.size() / slotSize);
+	reclaimed += ShrinkCapacity(array, capacity);
+	return true;
+}
+
+// Replaces a live component in place: destroys it and constructs the new one
+// at the same address, so overwriting costs one construction like adding does
+// (no temporary plus move assignment). args must not refer to component.
+template <typename T, typename ...TArgs>
+T& Reconstruct(T& component, TArgs&& ...args) {
+	component.~T();
+	return *::new (static_cast<void*>(&component)) T(std::forward<TArgs>(args)...);
+}
+
+/**
+ * IPool
+ * Type-erased interface the registry uses to manage a pool without knowing
+ * its component type or storage policy.
+ */
+class IPool {
+public: 
+	virtual ~IPool() {}
+
+	// Publishes the current values of a double buffered pool, no-op otherwise
+	virtual void SwapBuffers() {}
+
+	// Removes the entity's component without knowing its type
+	virtual void RemoveEntity(int entityId) = 0;
+	// Same for a batch, one virtual call for all of them
+	virtual void RemoveEntities(const std::vector<int>& entityIds) = 0;
+
+	// Drops every component, capacity is kept for the next level
+	virtual void Clear() = 0;
+	virtual void Reserve(int count) = 0;
+
+	// An empty pool of the same component type, for registries that have not
+	// seen the type yet
+	virtual std::shared_ptr<IPool> CreateEmpty() const = 0;
+	virtual bool IsDoubleBuffered() const { return false; }
+	// A ByteColumnPool, the storage of a component defined at runtime
+	virtual bool IsRuntime() const { return false; }
+	// Whether entityId may hold this component. Only a singleton owned by
+	// another entity refuses.
+	virtual bool CanAdd(int) const { return true; }
+
+	// Moves the components of sourceIds[i] into destination under
+	// destinationIds[i], one call per pool. Entities without the component are
+	// skipped. destination must hold the same component type.
+	virtual void MoveEntitiesTo(IPool& destination, const std::vector<int>& sourceIds, const std::vector<int>& destinationIds) = 0;
+
+	// Gives back memory left behind by churn, returns the bytes reclaimed. Does
+	// about slotBudget slots of work and subtracts what it used; a pool that
+	// runs out picks up where it stopped on the next call. A pool with nothing
+	// to reclaim returns without touching the budget.
+	virtual size_t Compact(size_t& slotBudget) = 0;
+
+	// Bytes held by the pool, spare capacity included
+	virtual size_t MemoryUsage() const = 0;
+};
+
+/**
+ * SparseSet
+ * Bookkeeping of a packed pool: a sparse array maps an entity id to its slot
+ * in the packed array and back. It lives outside Pool<T> so groups can
+ * reorder pools without knowing T.
+ */
+class SparseSet: public IPool {
+protected:
+	// entity id -> packed index (-1 if the entity has no component in this pool)
+	std::vector<int> entityIdToIndex;
+	// packed index -> entity id
+	std::vector<int> indexToEntityId;
+	// largest size since the last Compact, the capacity Compact keeps
+	size_t peakSize = 0;
+	// capacity asked for up front (constructor or Reserve), Compact never
+	// shrinks below it
+	size_t minimumCapacity = 0;
+
+	virtual void SwapData(int indexA, int indexB) = 0;
+
+	// Trims the index arrays within the budget, adding the bytes given back
+	// to reclaimed. Returns false if it ran out before finishing.
+	bool CompactIndex(size_t capacity, size_t& slotBudget, size_t& reclaimed);
+
+public: 
+	// The group that controls the ordering of this pool, nullptr if unowned
+	class Group* owner = nullptr;
+
+	bool isEmpty() const { return indexToEntityId.empty(); }
+
+	size_t GetSize() const { return indexToEntityId.size(); }
+
+	bool Contains(int entityId) const {
+		return entityId < static_cast<int>(entityIdToIndex.size()) && entityIdToIndex[entityId] != -1;
+	}
+
+	int IndexOf(int entityId) const { return entityIdToIndex[entityId]; }
+
+	int EntityAt(int index) const { return indexToEntityId[index]; }
+
+	const int* Entities() const { return indexToEntityId.data(); }
+
+	// Swaps two packed slots, keeping the sparse mapping in sync
+	void Swap(int indexA, int indexB);
+};
+
+/**
+ * Pool 
+ * Dense storage, the default: the components of type T are stored
+ * contiguously with no holes. Groups can only own dense pools.
+ */
+template <typename T>
+class Pool: public SparseSet {
+
+private:
+	static constexpr bool doubleBuffered = ComponentTraits<T>::doubleBuffered;
+	static constexpr size_t reservedCapacity = ComponentTraits<T>::reservedCapacity;
+
+	// A reserved address range when the traits ask for one, so growth never
+	// moves the components
+	using Storage = typename std::conditional<(reservedCapacity > 0), VirtualArray<T>, std::vector<T>>::type;
+
+	static Storage MakeStorage(bool used) {
+		if constexpr (reservedCapacity > 0) {
+			return used ? Storage(reservedCapacity, ComponentTraits<T>::hugePages) : Storage();
+		} else {
+			return Storage();
+		}
+	}
+
+	Storage data;
+	// Values as of the last SwapBuffers, same layout as data. Only used when
+	// the component is double buffered, which requires T to be copyable.
+	Storage published;
+
+	void SwapData(int indexA, int indexB) override { 
+		std::swap(data[indexA], data[indexB]); 
+		if constexpr (doubleBuffered) {
+			std::swap(published[indexA], published[indexB]);
+		}
+	}
+
+public:
+	Pool(int capacity = 100) : data(MakeStorage(true)), published(MakeStorage(doubleBuffered)) {
+		minimumCapacity = capacity;
+		data.reserve(capacity); 
+		indexToEntityId.reserve(capacity);
+		if constexpr (doubleBuffered) {
+			published.reserve(capacity);
+		}
+	}
+	virtual ~Pool() = default; 
+
+	void Clear() override { 
+		data.clear(); 
+		published.clear();
+		entityIdToIndex.clear();
+		indexToEntityId.clear();
+	}
+
+	void Reserve(int count) override {
+		minimumCapacity = std::max(minimumCapacity, static_cast<size_t>(count));
+		data.reserve(count);
+		if constexpr (doubleBuffered) {
+			published.reserve(count);
+		}
+		entityIdToIndex.reserve(count);
+		indexToEntityId.reserve(count);
+	}
+
+	// Constructs the component straight into the pool's spare capacity. An
+	// existing component is reconstructed in its slot.
+	template <typename ...TArgs>
+	T& Emplace(int entityId, TArgs&& ...args) {
+		if (Contains(entityId)) {
+			return Reconstruct(data[entityIdToIndex[entityId]], std::forward<TArgs>(args)...);
+		}
+		if (entityId >= static_cast<int>(entityIdToIndex.size())) {
+			entityIdToIndex.resize(entityId + 1, -1);
+		}
+		entityIdToIndex[entityId] = static_cast<int>(data.size());
+		indexToEntityId.push_back(entityId);
+		auto& component = data.emplace_back(std::forward<TArgs>(args)...);
+		// new components are visible to readers straight away
+		if constexpr (doubleBuffered) {
+			published.push_back(component);
+		}
+		peakSize = std::max(peakSize, data.size());
+		return component;
+	}
+
+	void Set(int entityId, T object) { Emplace(entityId, std::move(object)); }
+
+	void RemoveEntity(int entityId) override { Remove(entityId); }
+
+	void RemoveEntities(const std::vector<int>& entityIds) override {
+		for (auto entityId: entityIds) {
+			Remove(entityId);
+		}
+	}
+
+	std::shared_ptr<IPool> CreateEmpty() const override { return std::make_shared<Pool<T>>(); }
+
+	bool IsDoubleBuffered() const override { return doubleBuffered; }
+
+	void MoveEntitiesTo(IPool& destination, const std::vector<int>& sourceIds, const std::vector<int>& destinationIds) override {
+		auto& destinationPool = static_cast<Pool<T>&>(destination);
+		for (size_t i = 0; i < sourceIds.size(); i++) {
+			if (!Contains(sourceIds[i])) {
+				continue;
+			}
+			destinationPool.Emplace(destinationIds[i], std::move(Get(sourceIds[i])));
+			Remove(sourceIds[i]);
+		}
+	}
+
+	// Swap-and-pop: moves the last component into the removed slot, the
+	// removed one is destroyed by pop_back
+	void Remove(int entityId) {
+		if (!Contains(entityId)) {
+			return;
+		}
+		Swap(entityIdToIndex[entityId], static_cast<int>(data.size()) - 1);
+		entityIdToIndex[entityId] = -1;
+		indexToEntityId.pop_back();
+		data.pop_back();
+		if constexpr (doubleBuffered) {
+			published.pop_back();
+		}
+	}
+
+	// Gives back the capacity above the peak size seen since the last finished
+	// pass, never below what was reserved. The data itself is always packed at
+	// the front (removals swap-and-pop), so spare capacity is what churn leaves
+	// behind.
+	size_t Compact(size_t& slotBudget) override {
+		const auto capacity = std::max({ peakSize, data.size(), minimumCapacity });
+		size_t reclaimed = 0;
+		auto finished = CompactIndex(capacity, slotBudget, reclaimed) && 
+			ShrinkStep(data, capacity, slotBudget, reclaimed);
+		if constexpr (doubleBuffered) {
+			finished = finished && ShrinkStep(published, capacity, slotBudget, reclaimed);
+		}
+		if (finished) {
+			peakSize = data.size();
+		}
+		return reclaimed;
+	}
+
+	size_t MemoryUsage() const override {
+		return (data.capacity() + published.capacity()) * sizeof(T) + 
+			(entityIdToIndex.capacity() + indexToEntityId.capacity()) * sizeof(int);
+	}
+
+	// Copies the whole write side into published: O(n) in the pool size, one
+	// contiguous copy rather than per entity work. Systems update components
+	// in place, so a plain buffer flip would leave them writing over a frame
+	// two steps old. Must not run while a reader is using the published values.
+	void SwapBuffers() override {
+		if constexpr (doubleBuffered) {
+			std::copy(data.begin(), data.end(), published.begin());
+		}
+	}
+
+	T& Get(int entityId) { return static_cast<T&>(data[entityIdToIndex[entityId]]); }
+
+	T* Data() { return data.data(); }
+
+	// Read-only view of the last published frame, the current values if the
+	// component is not double buffered
+	const T& GetPublished(int entityId) const { 
+		if constexpr (doubleBuffered) {
+			return published[entityIdToIndex[entityId]];
+		}
+		return data[entityIdToIndex[entityId]];
+	}
+
+	const T* PublishedData() const { 
+		if constexpr (doubleBuffered) {
+			return published.data();
+		}
+		return data.data();
+	}
+
+	T& operator [](unsigned int index) { return data[index]; }
+
+};
+
+/**
+ * SparsePool
+ * Hash map from entity id to component, for rare (cold) components. Memory is
+ * proportional to the entities that have one and none of it sits next to the
+ * hot arrays the systems walk.
+ */
+template <typename T>
+class SparsePool: public IPool {
+
+private:
+	static_assert(!ComponentTraits<T>::doubleBuffered, "Double buffering needs dense storage");
+
+	std::unordered_map<int, T> data;
+
+public:
+	bool Contains(int entityId) const { return data.find(entityId) != data.end(); }
+
+	size_t GetSize() const { return data.size(); }
+
+	template <typename ...TArgs>
+	T& Emplace(int entityId, TArgs&& ...args) {
+		auto component = data.find(entityId);
+		if (component != data.end()) {
+			return Reconstruct(component->second, std::forward<TArgs>(args)...);
+		}
+		return data.try_emplace(entityId, std::forward<TArgs>(args)...).first->second;
+	}
+
+	void Set(int entityId, T object) { Emplace(entityId, std::move(object)); }
+
+	void Remove(int entityId) { data.erase(entityId); }
+
+	T& Get(int entityId) { return data.find(entityId)->second; }
+
+	const T& GetPublished(int entityId) const { return data.find(entityId)->second; }
+
+	void RemoveEntity(int entityId) override { Remove(entityId); }
+
+	void RemoveEntities(const std::vector<int>& entityIds) override {
+		for (auto entityId: entityIds) {
+			Remove(entityId);
+		}
+	}
+
+	void Clear() override { data.clear(); }
+
+	// Rare by definition, sizing for every entity would defeat the purpose
+	void Reserve(int) override {}
+
+	std::shared_ptr<IPool> CreateEmpty() const override { return std::make_shared<SparsePool<T>>(); }
+
+	void MoveEntitiesTo(IPool& destination, const std::vector<int>& sourceIds, const std::vector<int>& destinationIds) override {
+		auto& destinationPool = static_cast<SparsePool<T>&>(destination);
+		for (size_t i = 0; i < sourceIds.size(); i++) {
+			auto component = data.find(sourceIds[i]);
+			if (component == data.end()) {
+				continue;
+			}
+			destinationPool.Emplace(destinationIds[i], std::move(component->second));
+			data.erase(component);
+		}
+	}
+
+	// Rehashes to fit once under half the buckets are in use, charged a slot
+	// per component moved
+	size_t Compact(size_t& slotBudget) override {
+		if (data.size() >= data.bucket_count() * data.max_load_factor() / 2) {
+			return 0;
+		}
+		slotBudget -= std::min(slotBudget, data.size());
+		const auto buckets = data.bucket_count();
+		data.rehash(0);
+		return buckets > data.bucket_count() ? (buckets - data.bucket_count()) * sizeof(void*) : 0;
+	}
+
+	// Estimate: one node (value plus link) per component and a pointer per bucket
+	size_t MemoryUsage() const override {
+		return data.size() * (sizeof(typename std::unordered_map<int, T>::value_type) + sizeof(void*)) + 
+			data.bucket_count() * sizeof(void*);
+	}
+};
+
+/**
+ * PagedPool
+ * Components are stored in fixed size pages indexed directly by entity id; a
+ * page is allocated the first time one of its entities gets the component.
+ * No indirection and addresses never move, at the cost of holes. Suits
+ * components that most entities of an id range have.
+ */
+template <typename T>
+class PagedPool: public IPool {
+
+private:
+	static_assert(!ComponentTraits<T>::doubleBuffered, "Double buffering needs dense storage");
+
+	static const int PAGE_BITS = 8;
+	static const int PAGE_SIZE = 1 << PAGE_BITS;
+
+	struct Page {
+		std::bitset<PAGE_SIZE> present;
+		alignas(T) unsigned char storage[PAGE_SIZE * sizeof(T)];
+
+		T* Slot(int slot) { return reinterpret_cast<T*>(storage) + slot; }
+		const T* Slot(int slot) const { return reinterpret_cast<const T*>(storage) + slot; }
+
+		void Clear() {
+			for (int slot = 0; slot < PAGE_SIZE; slot++) {
+				if (present.test(slot)) {
+					Slot(slot)->~T();
+				}
+			}
+			present.reset();
+		}
+
+		~Page() { Clear(); }
+	};
+
+	std::vector<std::unique_ptr<Page>> pages;
+	size_t size = 0;
+	// next page Compact looks at
+	size_t compactionPage = 0;
+
+public:
+	bool Contains(int entityId) const {
+		const auto page = static_cast<size_t>(entityId >> PAGE_BITS);
+		return page < pages.size() && pages[page] && pages[page]->present.test(entityId & (PAGE_SIZE - 1));
+	}
+
+	size_t GetSize() const { return size; }
+
+	template <typename ...TArgs>
+	T& Emplace(int entityId, TArgs&& ...args) {
+		const auto pageIndex = static_cast<size_t>(entityId >> PAGE_BITS);
+		const auto slot = entityId & (PAGE_SIZE - 1);
+		if (pageIndex >= pages.size()) {
+			pages.resize(pageIndex + 1);
+		}
+		if (!pages[pageIndex]) {
+			pages[pageIndex] = std::make_unique<Page>();
+		}
+		auto& page = *pages[pageIndex];
+		if (page.present.test(slot)) {
+			return Reconstruct(*page.Slot(slot), std::forward<TArgs>(args)...);
+		}
+		auto component = new (page.Slot(slot)) T(std::forward<TArgs>(args)...);
+		page.present.set(slot);
+		size++;
+		return *component;
+	}
+
+	void Set(int entityId, T object) { Emplace(entityId, std::move(object)); }
+
+	void Remove(int entityId) {
+		if (!Contains(entityId)) {
+			return;
+		}
+		auto& page = *pages[entityId >> PAGE_BITS];
+		const auto slot = entityId & (PAGE_SIZE - 1);
+		page.Slot(slot)->~T();
+		page.present.reset(slot);
+		size--;
+	}
+
+	T& Get(int entityId) { return *pages[entityId >> PAGE_BITS]->Slot(entityId & (PAGE_SIZE - 1)); }
+
+	const T& GetPublished(int entityId) const { return *pages[entityId >> PAGE_BITS]->Slot(entityId & (PAGE_SIZE - 1)); }
+
+	void RemoveEntity(int entityId) override { Remove(entityId); }
+
+	void RemoveEntities(const std::vector<int>& entityIds) override {
+		for (auto entityId: entityIds) {
+			Remove(entityId);
+		}
+	}
+
+	// Pages stay allocated for the next level
+	void Clear() override {
+		for (auto& page: pages) {
+			if (page) {
+				page->Clear();
+			}
+		}
+		size = 0;
+	}
+
+	void Reserve(int count) override { pages.reserve((count + PAGE_SIZE - 1) >> PAGE_BITS); }
+
+	std::shared_ptr<IPool> CreateEmpty() const override { return std::make_shared<PagedPool<T>>(); }
+
+	void MoveEntitiesTo(IPool& destination, const std::vector<int>& sourceIds, const std::vector<int>& destinationIds) override {
+		auto& destinationPool = static_cast<PagedPool<T>&>(destination);
+		for (size_t i = 0; i < sourceIds.size(); i++) {
+			if (!Contains(sourceIds[i])) {
+				continue;
+			}
+			destinationPool.Emplace(destinationIds[i], std::move(Get(sourceIds[i])));
+			Remove(sourceIds[i]);
+		}
+	}
+
+	// Frees the pages nobody uses anymore, a slot of budget per page looked at
+	size_t Compact(size_t& slotBudget) override {
+		size_t reclaimed = 0;
+		for (; compactionPage < pages.size(); compactionPage++) {
+			if (slotBudget == 0) {
+				return reclaimed;
+			}
+			slotBudget--;
+			auto& page = pages[compactionPage];
+			if (page && page->present.none()) {
+				page.reset();
+				reclaimed += sizeof(Page);
+			}
+		}
+		compactionPage = 0;
+		return reclaimed;
+	}
+
+	size_t MemoryUsage() const override {
+		size_t bytes = pages.capacity() * sizeof(std::unique_ptr<Page>);
+		for (auto& page: pages) {
+			if (page) {
+				bytes += sizeof(Page);
+			}
+		}
+		return bytes;
+	}
+};
+
+/**
+ * SingletonPool
+ * Storage for a component only one entity has at a time, such as a camera or
+ * the game state.
+ */
+template <typename T>
+class SingletonPool: public IPool {
+
+private:
+	static_assert(!ComponentTraits<T>::doubleBuffered, "Double buffering needs dense storage");
+
+	int ownerId = -1;
+	std::optional<T> instance;
+
+public:
+	bool Contains(int entityId) const { return entityId == ownerId; }
+
+	size_t GetSize() const { return instance ? 1 : 0; }
+
+	bool CanAdd(int entityId) const override { return ownerId == -1 || ownerId == entityId; }
+
+	// A second owner is refused in every build: the instance stays with its
+	// owner and is returned untouched. The registry checks CanAdd first so
+	// signatures never claim a refused component.
+	template <typename ...TArgs>
+	T& Emplace(int entityId, TArgs&& ...args) {
+		if (!CanAdd(entityId)) {
+			LOG_ERROR(ECS, "Singleton component already on entity id " + std::to_string(ownerId) + ", refused for entity id " + std::to_string(entityId));
+			return *instance;
+		}
+		ownerId = entityId;
+		return instance.emplace(std::forward<TArgs>(args)...);
+	}
+
+	void Set(int entityId, T object) { Emplace(entityId, std::move(object)); }
+
+	void Remove(int entityId) {
+		if (!Contains(entityId)) {
+			return;
+		}
+		ownerId = -1;
+		instance.reset();
+	}
+
+	T& Get(int) { return *instance; }
+
+	const T& GetPublished(int) const { return *instance; }
+
+	void RemoveEntity(int entityId) override { Remove(entityId); }
+
+	void RemoveEntities(const std::vector<int>& entityIds) override {
+		for (auto entityId: entityIds) {
+			Remove(entityId);
+		}
+	}
+
+	void Clear() override { Remove(ownerId); }
+
+	void Reserve(int) override {}
+
+	std::shared_ptr<IPool> CreateEmpty() const override { return std::make_shared<SingletonPool<T>>(); }
+
+	void MoveEntitiesTo(IPool& destination, const std::vector<int>& sourceIds, const std::vector<int>& destinationIds) override {
+		auto& destinationPool = static_cast<SingletonPool<T>&>(destination);
+		for (size_t i = 0; i < sourceIds.size(); i++) {
+			if (!Contains(sourceIds[i])) {
+				continue;
+			}
+			// the destination already has one elsewhere: this one is dropped
+			// with its source entity
+			if (destinationPool.CanAdd(destinationIds[i])) {
+				destinationPool.Emplace(destinationIds[i], std::move(*instance));
+			}
+			Remove(sourceIds[i]);
+		}
+	}
+
+	size_t Compact(size_t&) override { return 0; }
+
+	size_t MemoryUsage() const override { return sizeof(instance); }
+};
+
+template <typename T, StoragePolicy = ComponentTraits<T>::storage>
+struct StorageFor { using type = Pool<T>; };
+
+template <typename T>
+struct StorageFor<T, StoragePolicy::Sparse> { using type = SparsePool<T>; };
+
+template <typename T>
+struct StorageFor<T, StoragePolicy::Paged> { using type = PagedPool<T>; };
+
+template <typename T>
+struct StorageFor<T, StoragePolicy::Singleton> { using type = SingletonPool<T>; };
+
+// The pool type the registry uses for T, picked at compile time from its traits
+template <typename T>
+using PoolFor = typename StorageFor<T>::type;
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef RUNTIMEPOOL_H
+#define RUNTIMEPOOL_H
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ECS/Pool.h"
+
+// Field types a runtime component can have, named after their Lua counterparts
+enum class FieldType {
+	Number,  // double
+	Integer, // int64_t
+	Boolean  // bool
+};
+
+struct FieldLayout {
+	std::string name;
+	FieldType type;
+	// bytes per component
+	size_t size;
+};
+
+/**
+ * ComponentLayout
+ * Field list of a component type declared at runtime, e.g. from a script,
+ * with no C++ struct behind it.
+ */
+class ComponentLayout {
+private:
+	std::string name;
+	std::vector<FieldLayout> fields;
+
+public:
+	explicit ComponentLayout(std::string name) : name(std::move(name)) {}
+
+	ComponentLayout& AddField(const std::string& fieldName, FieldType type);
+	// -1 if there is no such field
+	int FindField(const std::string& fieldName) const;
+	// Same field names and types in the same order
+	bool SameFields(const ComponentLayout& other) const;
+
+	const std::string& GetName() const { return name; }
+	const std::vector<FieldLayout>& GetFields() const { return fields; }
+
+	static size_t SizeOf(FieldType type);
+	static bool ParseType(const std::string& typeName, FieldType& type);
+};
+
+/**
+ * ByteColumnPool
+ * Dense storage for a runtime component type. Every field gets its own byte
+ * column, packed like the components of Pool<T>, so a field of all the
+ * components is one contiguous array. Fields are zeroed when a component is
+ * added.
+ */
+class ByteColumnPool: public SparseSet {
+private:
+	ComponentLayout layout;
+	// column i holds field i, the field of the component at packed index n
+	// starts at byte n * fields[i].size
+	std::vector<std::vector<unsigned char>> columns;
+
+	void SwapData(int indexA, int indexB) override;
+
+public:
+	explicit ByteColumnPool(ComponentLayout layout);
+
+	const ComponentLayout& GetLayout() const { return layout; }
+
+	// Adds a zeroed component, no-op if the entity already has one
+	void Add(int entityId);
+	// Swap-and-pop, like Pool<T>
+	void Remove(int entityId);
+
+	// Address of one field of the entity's component. The pointer is valid
+	// until the pool grows or the component moves.
+	unsigned char* Field(int entityId, int field) {
+		return columns[field].data() + entityIdToIndex[entityId] * layout.GetFields()[field].size;
+	}
+
+	// A whole field column, [0, GetSize()), T must match the field type
+	template <typename T> T* Column(int field) {
+		assert(sizeof(T) == layout.GetFields()[field].size && "column type does not match the field");
+		return reinterpret_cast<T*>(columns[field].data());
+	}
+
+	void RemoveEntity(int entityId) override { Remove(entityId); }
+	void RemoveEntities(const std::vector<int>& entityIds) override;
+	void Clear() override;
+	void Reserve(int count) override;
+	std::shared_ptr<IPool> CreateEmpty() const override { return std::make_shared<ByteColumnPool>(layout); }
+	bool IsRuntime() const override { return true; }
+	void MoveEntitiesTo(IPool& destination, const std::vector<int>& sourceIds, const std::vector<int>& destinationIds) override;
+	size_t Compact(size_t& slotBudget) override;
+	size_t MemoryUsage() const override;
+};
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef VIRTUALARRAY_H
+#define VIRTUALARRAY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <string>
+#include <utility>
+
+#include "Logger/Logger.h"
+
+/**
+ * VirtualMemory
+ * Thin wrapper over the OS calls that reserve address space and back it with
+ * memory on demand (VirtualAlloc on Windows, mmap/mprotect elsewhere).
+ */
+class VirtualMemory {
+public:
+	static size_t PageSize();
+	// Address space only, touching it faults until committed
+	static void* Reserve(size_t bytes);
+	static bool Commit(void* address, size_t bytes, bool hugePages);
+	static void Decommit(void* address, size_t bytes);
+	static void Release(void* address, size_t bytes);
+};
+
+/**
+ * VirtualArray
+ * Growable array that reserves room for maxElements up front and commits
+ * pages as it grows, so elements never move and references into it stay
+ * valid across growth. Offers the subset of std::vector the pools use.
+ * hugePages asks for transparent huge pages where the OS supports them.
+ */
+template <typename T>
+class VirtualArray {
+private:
+	// granularity of commits, keeps the number of system calls down
+	static const size_t COMMIT_CHUNK = 64 * 1024;
+	static const size_t HUGE_PAGE_CHUNK = 2 * 1024 * 1024;
+
+	T* elements = nullptr;
+	size_t count = 0;
+	// always a multiple of the chunk size, or the whole reservation
+	size_t committedBytes = 0;
+	size_t reserved = 0;
+	bool hugePages = false;
+
+	size_t ChunkBytes() const { return hugePages ? HUGE_PAGE_CHUNK : COMMIT_CHUNK; }
+
+	// Rounds up to whole chunks, capped at the reservation
+	size_t ChunkAligned(size_t elementCount) const {
+		const auto chunk = ChunkBytes();
+		return std::min((elementCount * sizeof(T) + chunk - 1) / chunk * chunk, ReservedBytes());
+	}
+
+	// Makes room for capacity elements. False (logged) when that is past the
+	// reservation or the OS refuses, committedBytes is left as it was.
+	bool Commit(size_t capacity) {
+		if (capacity * sizeof(T) <= committedBytes) {
+			return true;
+		}
+		if (!elements || capacity > reserved) {
+			LOG_ERROR(ECS, "VirtualArray grew past its reserved capacity of " + std::to_string(reserved));
+			return false;
+		}
+
+		const auto bytes = ChunkAligned(capacity);
+		if (!VirtualMemory::Commit(reinterpret_cast<char*>(elements) + committedBytes, bytes - committedBytes, hugePages)) {
+			return false;
+		}
+		committedBytes = bytes;
+		return true;
+	}
+
+	size_t ReservedBytes() const {
+		const auto page = VirtualMemory::PageSize();
+		return (reserved * sizeof(T) + page - 1) / page * page;
+	}
+
+public:
+	VirtualArray() = default;
+
+	VirtualArray(size_t maxElements, bool hugePages = false) : reserved(maxElements), hugePages(hugePages) {
+		if (reserved) {
+			elements = static_cast<T*>(VirtualMemory::Reserve(ReservedBytes()));
+		}
+	}
+
+	~VirtualArray() {
+		clear();
+		if (elements) {
+			VirtualMemory::Release(elements, ReservedBytes());
+		}
+	}
+
+	VirtualArray(const VirtualArray&) = delete;
+	VirtualArray& operator =(const VirtualArray&) = delete;
+
+	VirtualArray(VirtualArray&& other) noexcept { swap(other); }
+	VirtualArray& operator =(VirtualArray&& other) noexcept {
+		swap(other);
+		return *this;
+	}
+
+	void swap(VirtualArray& other) noexcept {
+		std::swap(elements, other.elements);
+		std::swap(count, other.count);
+		std::swap(committedBytes, other.committedBytes);
+		std::swap(reserved, other.reserved);
+		std::swap(hugePages, other.hugePages);
+	}
+
+	size_t size() const { return count; }
+	size_t capacity() const { return committedBytes / sizeof(T); }
+	bool empty() const { return count == 0; }
+
+	T* data() { return elements; }
+	const T* data() const { return elements; }
+	T* begin() { return elements; }
+	T* end() { return elements + count; }
+	const T* begin() const { return elements; }
+	const T* end() const { return elements + count; }
+
+	T& operator [](size_t index) { return elements[index]; }
+	const T& operator [](size_t index) const { return elements[index]; }
+
+	void reserve(size_t capacity) { Commit(std::min(capacity, reserved)); }
+
+	// Like std::vector, throws std::bad_alloc when there is no room left:
+	// the reservation is used up or memory could not be committed
+	template <typename ...TArgs>
+	T& emplace_back(TArgs&& ...args) {
+		if (!Commit(count + 1)) {
+			throw std::bad_alloc();
+		}
+		auto element = new (elements + count) T(std::forward<TArgs>(args)...);
+		count++;
+		return *element;
+	}
+
+	void push_back(const T& element) { emplace_back(element); }
+	void push_back(T&& element) { emplace_back(std::move(element)); }
+
+	void pop_back() { elements[--count].~T(); }
+
+	void clear() {
+		while (count) {
+			pop_back();
+		}
+	}
+
+	// Returns the pages above capacity (never below size) to the OS, keeps
+	// the reservation. Returns the bytes given back.
+	size_t Decommit(size_t capacity) {
+		const auto keepBytes = ChunkAligned(std::max(capacity, count));
+		if (keepBytes >= committedBytes) {
+			return 0;
+		}
+		const auto reclaimed = committedBytes - keepBytes;
+		VirtualMemory::Decommit(reinterpret_cast<char*>(elements) + keepBytes, reclaimed);
+		committedBytes = keepBytes;
+		return reclaimed;
+	}
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef FRAMETIMER_H
+#define FRAMETIMER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Frames the frame time statistics are computed over
+const size_t FRAME_TIME_SAMPLES = 120;
+
+/**
+ * FrameStats
+ * Frame times over the last FRAME_TIME_SAMPLES frames, in milliseconds
+ */
+struct FrameStats {
+  uint64_t frames = 0;
+  double lastFrameMs = 0.0;
+  double meanFrameMs = 0.0;
+  // Jitter: the spread of frame times around the mean
+  double frameVarianceMs2 = 0.0;
+  double frameStdDevMs = 0.0;
+  double minFrameMs = 0.0;
+  double maxFrameMs = 0.0;
+  // How early WaitForNextFrame stops sleeping and starts spinning
+  double sleepMarginMs = 0.0;
+};
+
+/**
+ * FrameTimer
+ * Measures frames on the steady clock (sub-microsecond on every platform we
+ * ship, unlike SDL_GetTicks) and paces them. A sleep alone oversleeps by up to
+ * a scheduler tick, so WaitForNextFrame sleeps until a margin before the
+ * deadline and spins the rest. The margin follows the oversleep measured on
+ * every sleep, starting from a short calibration at construction.
+ */
+class FrameTimer {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  FrameTimer();
+
+  // Starts the first frame and forgets earlier deadlines, when the loop
+  // (re)starts
+  void Start();
+
+  // Starts a frame, returns the seconds since the previous one started
+  double Tick();
+
+  // Returns once period seconds have passed since the frame before the
+  // current one started. Deadlines advance by whole periods, so the average
+  // rate holds even when single frames are late.
+  void WaitForNextFrame(double period);
+
+  const FrameStats& GetStats() const { return stats; }
+
+private:
+  Clock::time_point frameStart;
+  Clock::time_point deadline;
+  bool paced = false;
+
+  // Moving average and variance of the measured oversleep, in seconds
+  double oversleepMean = 0.0;
+  double oversleepVariance = 0.0;
+  double sleepMargin = 0.0;
+
+  double samples[FRAME_TIME_SAMPLES] = {};
+  size_t sampleCount = 0;
+  size_t nextSample = 0;
+  FrameStats stats;
+
+  void SleepUntil(Clock::time_point wakeTime);
+  void UpdateStats(double frameTime);
+};
+
+#endif
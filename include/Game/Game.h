@@ -2,20 +2,90 @@
 #define GAME_H
 
 #include "ECS/ECS.h"
+#include "Game/FrameTimer.h"
+#include "Game/InputRecorder.h"
+#include "Game/RenderPacket.h"
+#include "Game/TripleBuffer.h"
 #include "SDL.h"
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <sol/sol.hpp>
+#include <string>
+#include <vector>
 
-const int FPS = 60;
-const int MILLISECS_PER_FRAME = 1000 / FPS;
+// Simulation steps per second unless SetTickRate says otherwise
+const int DEFAULT_TICK_RATE = 60;
+// Frames per second the window is capped at unless SetTargetFrameRate (or
+// --fps) says otherwise
+const int DEFAULT_FRAME_RATE = 60;
+// Longest frame the simulation catches up on. After a stall (a breakpoint,
+// a dragged window) the rest is dropped instead of running ever more steps.
+const double MAX_FRAME_TIME = 0.25;
+// Pool compaction runs once a second within this budget
+const double COMPACTION_BUDGET_MS = 0.5;
+// F9 writes the profiler zones of this many seconds to PROFILE_EXPORT_PATH
+const double PROFILE_EXPORT_SECONDS = 10.0;
+const char *const PROFILE_EXPORT_PATH = "./profile.json";
 
 class Game {
 private:
-  bool isRunning;
-  int millisecsPreviousFrame = 0;
+  // Written by the input side, read by the simulation thread when pipelined
+  std::atomic<bool> isRunning{false};
+  bool vsync = true;
+  // vsync was asked for and the renderer reports it, presenting then paces
+  // the frames and WaitForNextFrame stays out of the way
+  bool vsyncActive = false;
+  // Simulate on a thread of its own, see Run
+  bool pipelined = false;
+  // No window, renderer or input, see RunHeadless
+  bool headless = false;
+  // Headless runs stop after this many frames or seconds, 0 for no limit
+  uint64_t frameLimit = 0;
+  double secondsLimit = 0.0;
+  // Frames per second WaitForNextFrame paces to when vsync is off or could
+  // not be enabled, 0 for uncapped
+  int targetFrameRate = DEFAULT_FRAME_RATE;
+  int tickRate = DEFAULT_TICK_RATE;
+  // Seconds per simulation step, 1 / tickRate
+  double fixedDeltaTime = 1.0 / DEFAULT_TICK_RATE;
+  // Frame time not yet simulated, less than one step after Update
+  double accumulator = 0.0;
+  FrameTimer frameTimer;
+  double secondsSinceStatsReport = 0.0;
+  int ticksSinceCompaction = 0;
+  // Steps simulated, the clock input is recorded and replayed against
+  uint64_t ticks = 0;
+
+  // Polled by ProcessInput, handled by the next Step
+  std::mutex inputMutex;
+  std::vector<SDL_Event> pendingInput;
+  std::vector<SDL_Event> stepInput;
+  std::string recordPath;
+  std::string replayPath;
+  InputRecorder inputRecorder;
+  InputPlayer inputPlayer;
+  // Input comes from inputPlayer, live input can only quit
+  bool replaying = false;
+  // Where Destroy writes every recorded profiler zone, if set
+  std::string profileExportPath;
   SDL_Window *window = nullptr;
   SDL_Renderer *renderer = nullptr;
 
   std::unique_ptr<Registry> registry; 
+  // Level scripts, they can declare their own component types
+  sol::state lua;
+
+  // From the simulation to the render stage
+  TripleBuffer<RenderPacket> renderPackets;
+  uint64_t framesSimulated = 0;
+
+  // Body of the simulation thread in pipelined mode
+  void RunSimulation();
+  // Steps back to back and prints the throughput
+  void RunHeadless();
+  // What the game does with one input event, from a Step
+  void HandleInput(const SDL_Event &event);
 
 public:
   Game();
@@ -23,11 +93,35 @@ public:
   void Initialize();
   void Run();
   void Setup();
+  void LoadLevel(int level);
   void ProcessInput();
+  // Runs as many fixed steps as the time since the last call covers
   void Update();
-  void Render();
+  // One simulation step of fixedDeltaTime seconds
+  void Step();
+  // Copies what is to be drawn out of the registry
+  void BuildRenderPacket(RenderPacket &packet);
+  // Draws a packet, on the thread that owns the renderer
+  void Render(const RenderPacket &packet);
   void Destroy();
 
+  // Call before Initialize for vsync, before Run for the tick rate
+  void SetTickRate(int ticksPerSecond);
+  void SetVsync(bool enabled) { vsync = enabled; }
+  void SetTargetFrameRate(int framesPerSecond) { targetFrameRate = framesPerSecond; }
+  void SetPipelined(bool enabled) { pipelined = enabled; }
+  // Call before Initialize
+  void SetHeadless(bool enabled) { headless = enabled; }
+  void SetFrameLimit(uint64_t frames) { frameLimit = frames; }
+  void SetSecondsLimit(double seconds) { secondsLimit = seconds; }
+  // Call before Run. A replay also sets the tick rate it was recorded at.
+  void SetInputRecording(const std::string &path) { recordPath = path; }
+  void SetInputReplay(const std::string &path) { replayPath = path; }
+  void SetProfileExport(const std::string &path) { profileExportPath = path; }
+
+  // Frame time and its variance over the last FRAME_TIME_SAMPLES frames
+  const FrameStats& GetFrameStats() const { return frameTimer.GetStats(); }
+
   int windowWidth;
   int windowHeight;
 };
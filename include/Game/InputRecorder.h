@@ -0,0 +1,73 @@
+#ifndef INPUTRECORDER_H
+#define INPUTRECORDER_H
+
+#include "SDL.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * One input event as recorded: the simulation step it was handled before and
+ * the fields of the SDL event that matter to the game, 32 bytes instead of
+ * SDL_Event's 56 plus timestamps and window ids that differ every run.
+ *
+ *   keys:          sym, scancode, mod, repeat
+ *   mouse buttons: button, x, y, clicks
+ *   mouse motion:  state, x, y, xrel, yrel
+ *   mouse wheel:   x, y, direction
+ */
+struct InputRecord {
+  uint64_t tick;
+  uint32_t type;
+  int32_t values[5];
+};
+
+/**
+ * InputRecorder
+ * Writes the events the simulation handles to a file, which starts with a
+ * header holding the tick rate. Events are tagged with their step, not with
+ * wall-clock time, so replaying them is independent of frame timing.
+ */
+class InputRecorder {
+public:
+  ~InputRecorder();
+
+  bool Open(const std::string &path, int tickRate);
+  void Close();
+  bool IsOpen() const { return file != nullptr; }
+
+  void Record(uint64_t tick, const SDL_Event &event);
+
+  // Keyboard, mouse and quit events, the ones the game reacts to. Window and
+  // device events would make a replay depend on the machine.
+  static bool IsRecordable(const SDL_Event &event);
+
+private:
+  std::FILE *file = nullptr;
+};
+
+/**
+ * InputPlayer
+ * Reads a whole recording up front, so a replay does no file I/O, and hands
+ * the events back step by step.
+ */
+class InputPlayer {
+public:
+  bool Open(const std::string &path);
+
+  int GetTickRate() const { return tickRate; }
+
+  // The next event recorded for tick, false once there are none left for it.
+  // Ticks are asked for in increasing order.
+  bool Next(uint64_t tick, SDL_Event &event);
+
+  bool IsFinished() const { return next == records.size(); }
+
+private:
+  std::vector<InputRecord> records;
+  size_t next = 0;
+  int tickRate = 0;
+};
+
+#endif
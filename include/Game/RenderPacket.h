@@ -0,0 +1,31 @@
+#ifndef RENDERPACKET_H
+#define RENDERPACKET_H
+
+#include <cstdint>
+#include <vector>
+
+// A filled rectangle in window coordinates
+struct DrawCommand {
+  int x;
+  int y;
+  int width;
+  int height;
+  uint8_t r, g, b, a;
+};
+
+/**
+ * RenderPacket
+ * Everything the render stage needs to draw one frame, copied out of the
+ * registry by the simulation. Once published it is only read, so the render
+ * stage never touches the ECS.
+ */
+struct RenderPacket {
+  uint64_t frame = 0;
+  uint8_t clearColor[4] = {21, 21, 21, 255};
+  std::vector<DrawCommand> commands;
+
+  // Keeps the capacity, packets are reused frame after frame
+  void Clear() { commands.clear(); }
+};
+
+#endif
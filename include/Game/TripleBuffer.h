@@ -0,0 +1,57 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * TripleBuffer
+ * Hands the newest value from one writer thread to one reader thread without
+ * locks or copies. The writer fills its own buffer and swaps it with the
+ * shared one; the reader swaps its own with the shared one when that holds
+ * something new. Neither side ever waits: the writer may overwrite values the
+ * reader skipped, the reader keeps its last value until a new one arrives.
+ */
+template <typename T>
+class TripleBuffer {
+private:
+  static constexpr uint8_t INDEX_MASK = 3;
+  // set in shared while it holds a value the reader has not taken
+  static constexpr uint8_t FRESH = 4;
+
+  T buffers[3];
+  // index of the buffer in the middle, plus FRESH
+  std::atomic<uint8_t> shared{1};
+  uint8_t writeIndex = 0;
+  uint8_t readIndex = 2;
+
+public:
+  // Writer side: the buffer to fill next. It holds an older value, reuse
+  // its capacity rather than reallocating.
+  T &GetWriteBuffer() { return buffers[writeIndex]; }
+
+  // Writer side: makes the write buffer the newest value
+  void Publish() {
+    const auto previous = shared.exchange(writeIndex | FRESH, std::memory_order_acq_rel);
+    writeIndex = previous & INDEX_MASK;
+  }
+
+  // Reader side: moves to the newest value, false if nothing was published
+  // since the last call
+  bool Acquire() {
+    if (!(shared.load(std::memory_order_relaxed) & FRESH)) {
+      return false;
+    }
+    const auto previous = shared.exchange(readIndex, std::memory_order_acq_rel);
+    readIndex = previous & INDEX_MASK;
+    return true;
+  }
+
+  // Reader side: the value taken by the last successful Acquire
+  const T &GetReadBuffer() const { return buffers[readIndex]; }
+
+  // Either side: whether a published value is waiting for the reader
+  bool HasUnread() const { return shared.load(std::memory_order_acquire) & FRESH; }
+};
+
+#endif
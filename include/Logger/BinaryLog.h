@@ -0,0 +1,143 @@
+#ifndef BINARYLOG_H
+#define BINARYLOG_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#include "Logger/Logger.h"
+
+/**
+ * Layout of a binary log file, shared with the decoder (tools/LogDecoder.cpp).
+ * All integers are little endian, as written by the engine.
+ *
+ *   file    := MAGIC record*
+ *   record  := 'F' id:u32 level:u8 category:u8 line:u32 file:str format:str
+ *            | 'E' id:u32 nanoseconds:i64 size:u16 argument*   (size bytes)
+ *   argument:= 'i' i64 | 'u' u64 | 'd' f64 | 'b' u8 | 's' str
+ *   str     := length:u16 bytes
+ *
+ * A format ('F') always precedes the events ('E') that use its id.
+ */
+namespace BinaryLogFormat {
+  const char MAGIC[8] = { 'P', '2', 'D', 'L', 'O', 'G', '1', '\0' };
+  const char FORMAT_RECORD = 'F';
+  const char EVENT_RECORD = 'E';
+  const char INT_ARGUMENT = 'i';
+  const char UINT_ARGUMENT = 'u';
+  const char DOUBLE_ARGUMENT = 'd';
+  const char BOOL_ARGUMENT = 'b';
+  const char STRING_ARGUMENT = 's';
+  // longer string arguments are truncated
+  const size_t MAX_STRING_ARGUMENT = 1024;
+  // an event's arguments must fit its 16 bit size, larger events are dropped
+  const size_t MAX_EVENT_PAYLOAD = 0xFFFF;
+}
+
+/**
+ * BinaryLog
+ * Structured log for high volume events. A call site registers its format
+ * string once and gets an id; each event then stores the id, a timestamp and
+ * the raw argument bytes in a per-thread buffer. Nothing is formatted in the
+ * engine: the decoder renders the file to text offline, replacing each {} of
+ * the format with the next argument.
+ */
+class BinaryLog {
+public:
+  // Starts writing to path, truncating it. Formats registered before are
+  // written out first.
+  static bool Open(const std::string& path);
+  static void Close();
+  static bool IsOpen() { return open.load(std::memory_order_relaxed); }
+
+  static uint32_t RegisterFormat(LogLevel level, LogCategory category, const char* file, int line, const char* format);
+
+  // Hands the calling thread's buffered events to the file. Buffers are also
+  // flushed when full and when their thread exits.
+  static void Flush();
+
+  template <typename ...TArgs>
+  static void Write(uint32_t formatId, const TArgs& ...args);
+
+private:
+  static std::atomic<bool> open;
+
+  // Space for one event in the calling thread's buffer. nullptr, after
+  // logging, if the payload is over MAX_EVENT_PAYLOAD or the event would not
+  // fit even an empty buffer.
+  static unsigned char* Reserve(uint32_t formatId, size_t payload, size_t size);
+  static int64_t Now();
+
+  template <typename T> static size_t EncodedSize(const T& value);
+  static size_t EncodedSize(const std::string& value) { return 3 + std::min(value.size(), BinaryLogFormat::MAX_STRING_ARGUMENT); }
+  static size_t EncodedSize(const char* value) { return 3 + std::min(std::strlen(value), BinaryLogFormat::MAX_STRING_ARGUMENT); }
+
+  template <typename T> static unsigned char* Encode(unsigned char* output, const T& value);
+  static unsigned char* Encode(unsigned char* output, const std::string& value) { return EncodeString(output, value.data(), value.size()); }
+  static unsigned char* Encode(unsigned char* output, const char* value) { return EncodeString(output, value, std::strlen(value)); }
+  static unsigned char* EncodeString(unsigned char* output, const char* value, size_t length);
+
+  template <typename T> static unsigned char* Put(unsigned char* output, const T& value) {
+    std::memcpy(output, &value, sizeof(T));
+    return output + sizeof(T);
+  }
+};
+
+template <typename T>
+size_t BinaryLog::EncodedSize(const T&) {
+  static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "binary log arguments are numbers, enums, bools or strings");
+  return std::is_same<T, bool>::value ? 2 : 9;
+}
+
+template <typename T>
+unsigned char* BinaryLog::Encode(unsigned char* output, const T& value) {
+  if constexpr (std::is_same<T, bool>::value) {
+    *output++ = BinaryLogFormat::BOOL_ARGUMENT;
+    *output++ = value ? 1 : 0;
+    return output;
+  } else if constexpr (std::is_floating_point<T>::value) {
+    *output++ = BinaryLogFormat::DOUBLE_ARGUMENT;
+    return Put(output, static_cast<double>(value));
+  } else if constexpr (std::is_enum<T>::value || std::is_signed<T>::value) {
+    *output++ = BinaryLogFormat::INT_ARGUMENT;
+    return Put(output, static_cast<int64_t>(value));
+  } else {
+    *output++ = BinaryLogFormat::UINT_ARGUMENT;
+    return Put(output, static_cast<uint64_t>(value));
+  }
+}
+
+template <typename ...TArgs>
+void BinaryLog::Write(uint32_t formatId, const TArgs& ...args) {
+  const size_t payload = (size_t(0) + ... + EncodedSize(args));
+  const size_t size = 1 + sizeof(uint32_t) + sizeof(int64_t) + sizeof(uint16_t) + payload;
+
+  unsigned char* output = Reserve(formatId, payload, size);
+  if (!output) {
+    return;
+  }
+  *output++ = BinaryLogFormat::EVENT_RECORD;
+  output = Put(output, formatId);
+  output = Put(output, Now());
+  output = Put(output, static_cast<uint16_t>(payload));
+  ((output = Encode(output, args)), ...);
+}
+
+// LOG_EVENT(LOG_LEVEL_DEBUG, ECS, "Component {} added to entity {}", componentId, entityId)
+// Costs a branch when the binary log is closed or the level or category is
+// disabled (the arguments are not evaluated then), a memcpy otherwise. Levels
+// below LOG_COMPILE_LEVEL are discarded at compile time.
+#define LOG_EVENT(level, category, format, ...) \
+  do { \
+    if constexpr (level >= LOG_COMPILE_LEVEL) { \
+      if (BinaryLog::IsOpen() && Logger::IsEnabled(level, LOG_CATEGORY_##category)) { \
+        static const uint32_t logFormatId = BinaryLog::RegisterFormat(level, LOG_CATEGORY_##category, __FILE__, __LINE__, format); \
+        BinaryLog::Write(logFormatId, __VA_ARGS__); \
+      } \
+    } \
+  } while (0)
+
+#endif
@@ -1,20 +1,119 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
+#include <atomic>
+#include <cstdint>
 #include <string>
-#include <vector>
 
-enum LogType { LOG_INFO, LOG_WARNING, LOG_ERROR };
+enum LogType { LOG_TYPE_INFO, LOG_TYPE_WARNING, LOG_TYPE_ERROR };
 
+// Severity of a LOG_* macro call, in increasing order
+enum LogLevel { LOG_LEVEL_TRACE, LOG_LEVEL_DEBUG, LOG_LEVEL_INFO, LOG_LEVEL_WARN, LOG_LEVEL_ERROR, LOG_LEVEL_OFF };
+
+// Subsystem a message comes from, one bit each in the runtime category mask
+enum LogCategory { LOG_CATEGORY_CORE, LOG_CATEGORY_ECS, LOG_CATEGORY_RENDER, LOG_CATEGORY_ASSET, LOG_CATEGORY_SCRIPT };
+
+// Lowest level compiled in, set by the build (meson option log_level).
+// Calls below it are removed by the preprocessor, arguments included.
+#ifndef LOG_COMPILE_LEVEL
+#ifdef NDEBUG
+#define LOG_COMPILE_LEVEL 2
+#else
+#define LOG_COMPILE_LEVEL 0
+#endif
+#endif
+
+// Formatted lines longer than this are truncated in the history
+const size_t LOG_ENTRY_LENGTH = 256;
+// Lines kept in memory for an on-screen console
+const size_t LOG_HISTORY_SIZE = 1024;
+
+// One formatted line of the history, fixed size so keeping it never allocates
 struct LogEntry {
   LogType type;
-  std::string message;
+  LogCategory category;
+  // null-terminated
+  char message[LOG_ENTRY_LENGTH];
 };
 
+/**
+ * Logger
+ * Log and Err copy the message into a lock-free ring and return; a background
+ * thread timestamps, formats and writes the records. When the ring is full the
+ * record is dropped and counted rather than blocking the caller.
+ */
 class Logger {
 public:
-  static std::vector<LogEntry> messages;
   static void Log(const std::string &message);
+  // Errors are flushed before returning, they often precede an assert
   static void Err(const std::string &message);
+
+  // Blocks until every record logged so far has been written
+  static void Flush();
+  // Records lost to a full ring since startup
+  static uint64_t GetDroppedCount();
+
+  // Copies the newest lines of the history, at most count, oldest first.
+  // Returns how many were copied. Call Flush first to include everything.
+  static size_t CopyHistory(LogEntry *entries, size_t count);
+  // Appends lines pushed out of the history to the file at path, and the rest
+  // of the history at exit. Returns false if the file can't be opened.
+  static bool SpillHistoryTo(const std::string &path);
+
+  // Runtime filter for the levels that were compiled in: messages below the
+  // level, or from a category whose bit is clear, are skipped before their
+  // arguments are evaluated
+  static std::atomic<int> runtimeLevel;
+  static std::atomic<uint32_t> categoryMask;
+  static void SetLevel(LogLevel level) { runtimeLevel.store(level, std::memory_order_relaxed); }
+  static void SetCategoryEnabled(LogCategory category, bool enabled);
+
+  static bool IsEnabled(LogLevel level, LogCategory category) {
+    return level >= runtimeLevel.load(std::memory_order_relaxed) &&
+           (categoryMask.load(std::memory_order_relaxed) >> category & 1u);
+  }
+
+  // What the LOG_* macros call once the checks passed
+  static void Write(LogLevel level, LogCategory category, const std::string &message);
 };
-#endif
\ No newline at end of file
+
+// LOG_DEBUG(ECS, "Entity " + std::to_string(id) + " created"): the category is
+// the suffix of a LogCategory. The message expression is only evaluated when
+// the call is both compiled in and enabled at runtime.
+#define LOG_AT(level, category, message) \
+  do { \
+    if (Logger::IsEnabled(level, LOG_CATEGORY_##category)) { \
+      Logger::Write(level, LOG_CATEGORY_##category, message); \
+    } \
+  } while (0)
+
+#if LOG_COMPILE_LEVEL <= 0
+#define LOG_TRACE(category, message) LOG_AT(LOG_LEVEL_TRACE, category, message)
+#else
+#define LOG_TRACE(category, message) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= 1
+#define LOG_DEBUG(category, message) LOG_AT(LOG_LEVEL_DEBUG, category, message)
+#else
+#define LOG_DEBUG(category, message) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= 2
+#define LOG_INFO(category, message) LOG_AT(LOG_LEVEL_INFO, category, message)
+#else
+#define LOG_INFO(category, message) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= 3
+#define LOG_WARN(category, message) LOG_AT(LOG_LEVEL_WARN, category, message)
+#else
+#define LOG_WARN(category, message) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= 4
+#define LOG_ERROR(category, message) LOG_AT(LOG_LEVEL_ERROR, category, message)
+#else
+#define LOG_ERROR(category, message) ((void)0)
+#endif
+#endif
@@ -0,0 +1,76 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <typeinfo>
+
+// Set by the build (meson option profiler). When 0 the PROFILE_* macros
+// expand to nothing, so zones cost nothing and need no profiler at runtime.
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 0
+#endif
+
+// Zones kept per thread, the oldest are overwritten
+const size_t PROFILER_ZONES_PER_THREAD = 1 << 16;
+
+/**
+ * Profiler
+ * Scoped CPU timing zones. Each thread records the zones it closes into a
+ * ring of its own without taking any lock; the exporter copies the rings
+ * while they are written. The rings outlive their threads so a trace can
+ * still show a thread that has finished. Zones nest by time: a zone opened
+ * inside another ends inside it too.
+ */
+class Profiler {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// Appends a finished zone to the calling thread's ring. name must
+	// outlive the profiler, a literal or an InternName result.
+	static void Record(const char* name, Clock::time_point start, Clock::time_point end);
+
+	// Names the calling thread in exported traces, no-op when profiling is
+	// compiled out
+	static void SetThreadName(const std::string& name);
+
+	// A readable, permanent name for a type, for zones named after systems
+	static const char* InternName(const std::type_info& type);
+
+	// Writes the recorded zones as Chrome trace-event JSON, which Perfetto and
+	// chrome://tracing load. lastSeconds > 0 keeps only the zones that ended
+	// in that many seconds before the call. False if the file can't be
+	// written or profiling was compiled out.
+	static bool ExportChromeTrace(const std::string& path, double lastSeconds = 0.0);
+};
+
+/**
+ * ProfileZone
+ * Times its own lifetime, use through PROFILE_ZONE
+ */
+class ProfileZone {
+private:
+	const char* name;
+	Profiler::Clock::time_point start;
+
+public:
+	explicit ProfileZone(const char* name) : name(name), start(Profiler::Clock::now()) {}
+	~ProfileZone() { Profiler::Record(name, start, Profiler::Clock::now()); }
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+// PROFILE_ZONE("Registry::Update") times the rest of the enclosing scope
+#if PROFILER_ENABLED
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef SCRIPTCOMPONENTS_H
+#define SCRIPTCOMPONENTS_H
+
+#include <sol/sol.hpp>
+
+#include "ECS/ECS.h"
+
+/**
+ * Lets Lua scripts declare component types and use them on entities:
+ *
+ *   Health = define_component("Health", { hp = "number", regen = "number" })
+ *   local tank = create_entity()
+ *   tank:add(Health).hp = 100
+ *   each(Health, function(entity, health) health.hp = health.hp + health.regen end)
+ *   query({ Health, Armor }, function(entity, health, armor) ... end)
+ *
+ * Field types are "number", "integer" and "boolean". Components reach Lua as
+ * userdata pointing into the pool, so reading or writing a field touches the
+ * pool's column directly instead of copying the component into a table.
+ */
+void BindScriptComponents(sol::state& lua, Registry& registry);
+
+#endif
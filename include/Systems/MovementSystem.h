@@ -13,11 +13,15 @@ public:
 	}
 
 	void Update(double deltaTime) {
+		// The group packs both pools in the same order, so index i is the same entity
+		auto group = registry->GetGroup<Owned<TransformComponent, RigidBodyComponent>>();
+		auto transforms = group.Data<TransformComponent>();
+		const auto rigidBodies = group.Data<RigidBodyComponent>();
 
-		for (auto entity : GetSystemEntities()) {
+		for (size_t i = 0; i < group.Size(); i++) {
 			// Update entity position based on its velocity
-			auto& transform = entity.GetComponent<TransformComponent>();
-			const auto rigidBody = entity.GetComponent<RigidBodyComponent>();
+			auto& transform = transforms[i];
+			const auto& rigidBody = rigidBodies[i];
 
 			transform.position.x += rigidBody.velocity.x * deltaTime;
 			transform.position.y += rigidBody.velocity.y * deltaTime;
@@ -4,9 +4,7 @@
 #include "Components/SpriteComponent.h"
 #include "Components/TransformComponent.h"
 #include "ECS/ECS.h"
-
-#include "SDL.h"
-#include "SDL_render.h"
+#include "Game/RenderPacket.h"
 
 
 
@@ -17,22 +15,26 @@ public:
         RequireComponent<SpriteComponent>();
     }
 
-    void Update(SDL_Renderer* renderer) {
-
-        for (auto entity : GetSystemEntities()) {
-            const auto transform = entity.GetComponent<TransformComponent>();
-            const auto sprite = entity.GetComponent<SpriteComponent>();
-
-            SDL_Rect objRect = { 
-                static_cast<int>(transform.position.x),
-                static_cast<int>(transform.position.y),
+    // alpha is how far the present is between the previous simulation step
+    // (0) and the last one (1)
+    // Appends a draw command per sprite to packet, the render stage submits them
+    void Update(RenderPacket& packet, double alpha) {
+
+        // TransformComponent is owned by the movement group, so it is observed here.
+        // Its published frame is the step before the current one.
+        auto group = registry->GetGroup<Owned<SpriteComponent>, Observed<TransformComponent>>();
+
+        group.EachWithPublished([&packet, alpha](const SpriteComponent& sprite, const TransformComponent& transform,
+                                                  const SpriteComponent&, const TransformComponent& previousTransform) {
+            const auto position = glm::mix(previousTransform.position, transform.position, static_cast<float>(alpha));
+            packet.commands.push_back(DrawCommand{ 
+                static_cast<int>(position.x),
+                static_cast<int>(position.y),
                 sprite.width,
-                sprite.height
-            };
-
-            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-            SDL_RenderFillRect(renderer,&objRect);
-        }
+                sprite.height,
+                255, 255, 255, 255
+            });
+        });
     }
 };
 
@@ -0,0 +1,190 @@
+#include "Logger/BinaryLog.h"
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+std::atomic<bool> BinaryLog::open{false};
+
+namespace {
+
+// bytes of events a thread gathers before writing them out
+const size_t THREAD_BUFFER_SIZE = 64 * 1024;
+
+struct FormatDefinition {
+	LogLevel level;
+	LogCategory category;
+	const char* file;
+	int line;
+	const char* format;
+};
+
+/**
+ * The file and the registered formats. Formats are kept so that a file opened
+ * later still starts with every format its events may refer to.
+ */
+class BinaryLogFile {
+private:
+	std::mutex mutex;
+	std::FILE* file = nullptr;
+	std::vector<FormatDefinition> formats;
+
+	void WriteString(const char* text) {
+		const auto length = static_cast<uint16_t>(std::min(std::strlen(text), BinaryLogFormat::MAX_STRING_ARGUMENT));
+		std::fwrite(&length, sizeof(length), 1, file);
+		std::fwrite(text, 1, length, file);
+	}
+
+	void WriteFormat(uint32_t id, const FormatDefinition& format) {
+		const uint8_t level = static_cast<uint8_t>(format.level);
+		const uint8_t category = static_cast<uint8_t>(format.category);
+		const uint32_t line = static_cast<uint32_t>(format.line);
+		std::fputc(BinaryLogFormat::FORMAT_RECORD, file);
+		std::fwrite(&id, sizeof(id), 1, file);
+		std::fwrite(&level, sizeof(level), 1, file);
+		std::fwrite(&category, sizeof(category), 1, file);
+		std::fwrite(&line, sizeof(line), 1, file);
+		WriteString(format.file);
+		WriteString(format.format);
+	}
+
+public:
+	~BinaryLogFile() {
+		Close();
+	}
+
+	bool Open(const std::string& path) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (file) {
+			std::fclose(file);
+		}
+		file = std::fopen(path.c_str(), "wb");
+		if (!file) {
+			return false;
+		}
+		std::fwrite(BinaryLogFormat::MAGIC, 1, sizeof(BinaryLogFormat::MAGIC), file);
+		for (size_t i = 0; i < formats.size(); i++) {
+			WriteFormat(static_cast<uint32_t>(i), formats[i]);
+		}
+		return true;
+	}
+
+	void Close() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (file) {
+			std::fclose(file);
+			file = nullptr;
+		}
+	}
+
+	uint32_t Register(const FormatDefinition& format) {
+		std::lock_guard<std::mutex> lock(mutex);
+		const auto id = static_cast<uint32_t>(formats.size());
+		formats.push_back(format);
+		if (file) {
+			WriteFormat(id, format);
+		}
+		return id;
+	}
+
+	void Append(const unsigned char* data, size_t size, bool flush) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (file) {
+			std::fwrite(data, 1, size, file);
+			if (flush) {
+				std::fflush(file);
+			}
+		}
+	}
+};
+
+BinaryLogFile& GetFile() {
+	static BinaryLogFile file;
+	return file;
+}
+
+/**
+ * Events of one thread, written to the file in one go when full, on Flush and
+ * when the thread exits. Events a thread logs are thus in order in the file;
+ * events of different threads are ordered by their timestamp.
+ */
+struct ThreadBuffer {
+	unsigned char data[THREAD_BUFFER_SIZE];
+	size_t size = 0;
+
+	~ThreadBuffer() {
+		Write(false);
+	}
+
+	void Write(bool flush) {
+		if (size > 0 || flush) {
+			GetFile().Append(data, size, flush);
+			size = 0;
+		}
+	}
+};
+
+ThreadBuffer& GetThreadBuffer() {
+	// constructing the file first makes it outlive the buffers
+	GetFile();
+	thread_local ThreadBuffer buffer;
+	return buffer;
+}
+
+}
+
+bool BinaryLog::Open(const std::string& path) {
+	const auto opened = GetFile().Open(path);
+	open.store(opened, std::memory_order_relaxed);
+	if (!opened) {
+		LOG_ERROR(CORE, "Failed to open the binary log " + path);
+	}
+	return opened;
+}
+
+void BinaryLog::Close() {
+	if (!open.exchange(false, std::memory_order_relaxed)) {
+		return;
+	}
+	// other threads' buffered events are lost with the file
+	GetThreadBuffer().Write(true);
+	GetFile().Close();
+}
+
+uint32_t BinaryLog::RegisterFormat(LogLevel level, LogCategory category, const char* file, int line, const char* format) {
+	return GetFile().Register(FormatDefinition{ level, category, file, line, format });
+}
+
+void BinaryLog::Flush() {
+	if (IsOpen()) {
+		GetThreadBuffer().Write(true);
+	}
+}
+
+unsigned char* BinaryLog::Reserve([[maybe_unused]] uint32_t formatId, size_t payload, size_t size) {
+	if (payload > BinaryLogFormat::MAX_EVENT_PAYLOAD || size > THREAD_BUFFER_SIZE) {
+		LOG_ERROR(CORE, "Dropped a binary log event of format " + std::to_string(formatId) + ", " +
+			std::to_string(size) + " bytes is too large");
+		return nullptr;
+	}
+	auto& buffer = GetThreadBuffer();
+	if (buffer.size + size > THREAD_BUFFER_SIZE) {
+		buffer.Write(false);
+	}
+	auto output = buffer.data + buffer.size;
+	buffer.size += size;
+	return output;
+}
+
+int64_t BinaryLog::Now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+unsigned char* BinaryLog::EncodeString(unsigned char* output, const char* value, size_t length) {
+	const auto clamped = static_cast<uint16_t>(std::min(length, BinaryLogFormat::MAX_STRING_ARGUMENT));
+	*output++ = BinaryLogFormat::STRING_ARGUMENT;
+	output = Put(output, clamped);
+	std::memcpy(output, value, clamped);
+	return output + clamped;
+}
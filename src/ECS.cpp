@@ -1,55 +1,386 @@
 #include "ECS/ECS.h"
 #include "Logger/Logger.h"
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
 int IComponent::nextId = 0; 
+std::unordered_map<std::string, int> RuntimeComponent::ids;
+
+int RuntimeComponent::GetId(const std::string& name) {
+	auto id = ids.find(name);
+	if (id == ids.end()) {
+		id = ids.insert(std::make_pair(name, nextId++)).first;
+	}
+	return id->second;
+}
+
+int RuntimeComponent::FindId(const std::string& name) {
+	auto id = ids.find(name);
+	return id == ids.end() ? -1 : id->second;
+}
 
 int Entity::GetId() const {
-	return id; 
+	return handle.GetId(); 
+}
+
+void Entity::Kill() {
+	registry->KillEntity(*this);
 }
 
 void System::AddEntityToSystem(Entity entity) {
-	entities.push_back(entity);
+	entities.push_back(entity.GetHandle());
 } 
 
 void System::RemoveEntityFromSystem(Entity entity) {
 
 	// fun way to erase an element from a vector based on equality overload
-	// the comparison operator checks if the ids are equal 
+	// the comparison operator checks if the handles are equal 
+	entities.erase(std::remove(entities.begin(), entities.end(), entity.GetHandle()), entities.end());
+}
+
+void System::AddEntitiesToSystem(const std::vector<EntityHandle>& batch) {
+	entities.insert(entities.end(), batch.begin(), batch.end());
+}
+
+void System::RemoveKilledEntities(const std::vector<bool>& pendingKill) {
 	entities.erase(std::remove_if(entities.begin(), entities.end(),
-    					[&entity](Entity other){ 
-    						return entity == other; 
-    					}), entities.end());
+						[&pendingKill](EntityHandle entity) {
+							// ids created after the last kill are past the end and not pending
+							return entity.GetId() < static_cast<int>(pendingKill.size()) && pendingKill[entity.GetId()];
+						}), entities.end());
 }
 
-std::vector<Entity> System::GetSystemEntities() const {
+void System::ClearEntities() {
+	entities.clear();
+}
+
+void System::ReserveEntities(int count) {
+	entities.reserve(count);
+}
+
+const std::vector<EntityHandle>& System::GetSystemEntities() const {
 	return entities; 
 }
 
+Entity System::GetEntity(EntityHandle handle) const {
+	return Entity(handle, registry);
+}
+
+void System::RequireComponent(int componentId) {
+	componentSignature.set(componentId);
+}
+
 const Signature& System::GetComponentSignature() const {
 	return componentSignature;
 }
 
-Entity Registry::CreateEntity() {
+Group::Group(const Signature& ownedSignature, const Signature& signature, std::vector<SparseSet*> ownedPools)
+	: ownedSignature(ownedSignature), signature(signature), ownedPools(std::move(ownedPools)) {
+
+	for (auto pool: this->ownedPools) {
+		if (pool->owner) {
+			LOG_ERROR(ECS, "Component pool is already owned by another group");
+		}
+		assert(!pool->owner && "a component pool can only be owned by one group");
+		pool->owner = this;
+	}
+}
 
-	int entityId;
-	entityId = numEntities++;
-	Entity entity(entityId); 
-	entity.registry = this; 
-	entitiesToBeAdded.insert(entity);
+bool Group::Contains(int entityId) const {
+	const auto pool = ownedPools[0];
+	return pool->Contains(entityId) && pool->IndexOf(entityId) < static_cast<int>(size);
+}
 
-	if(entityId >= static_cast<int>(entityComponentSignatures.size())) {
-		entityComponentSignatures.resize(entityId + 1);
+void Group::OnComponentAdded(int entityId, const Signature& entitySignature) {
+	if ((entitySignature & signature) != signature || Contains(entityId)) {
+		return;
 	}
-	
-	Logger::Log("Entity created with id = " + std::to_string(entityId));
-	
+	// the first slot after the group becomes the entity's slot in every pool
+	for (auto pool: ownedPools) {
+		pool->Swap(pool->IndexOf(entityId), static_cast<int>(size));
+	}
+	size++;
+}
+
+void Group::OnComponentRemoved(int entityId) {
+	if (!Contains(entityId)) {
+		return;
+	}
+	size--;
+	// swap with the last member so the group stays packed
+	for (auto pool: ownedPools) {
+		pool->Swap(pool->IndexOf(entityId), static_cast<int>(size));
+	}
+}
+
+void Observer::Push(ComponentEvent event, int entityId) {
+	switch (event) {
+	case ComponentEvent::Construct:
+		pendingConstructed.push_back(entityId);
+		break;
+	case ComponentEvent::Update:
+		pendingUpdated.push_back(entityId);
+		break;
+	case ComponentEvent::Destroy:
+		pendingDestroyed.push_back(entityId);
+		break;
+	}
+}
+
+void Observer::Discard() {
+	pendingConstructed.clear();
+	pendingUpdated.clear();
+	pendingDestroyed.clear();
+}
+
+void Observer::Deliver() {
+	if (pendingConstructed.empty() && pendingUpdated.empty() && pendingDestroyed.empty()) {
+		return;
+	}
+	// swapping keeps the capacity of both buffer sets, so steady state delivery
+	// does not allocate
+	constructed.swap(pendingConstructed);
+	updated.swap(pendingUpdated);
+	destroyed.swap(pendingDestroyed);
+
+	handler(*this);
+
+	constructed.clear();
+	updated.clear();
+	destroyed.clear();
+}
+
+Entity Registry::CreateEntity() {
+
+	const auto entityId = entityIds.Allocate();
+
+	// recycled ids may carry a stale signature
+	entityComponentSignatures.EnsurePage(entityId);
+	entityComponentSignatures[entityId].reset();
+	entityGenerations.EnsurePage(entityId);
+
+	Entity entity(EntityHandle(entityId, entityGenerations[entityId]), this); 
+
+	entitiesToBeAdded.Push(entityId);
+
 	return entity; 
 }
 
+EntityHandle Registry::GetHandle(int entityId) const {
+	return EntityHandle(entityId, entityGenerations[entityId]);
+}
+
+bool Registry::IsAlive(EntityHandle handle) const {
+	const auto entityId = handle.GetId();
+	return entityId < entityIds.GetHighWaterMark() && entityGenerations[entityId] == handle.GetGeneration();
+}
+
+void Registry::KillEntity(Entity entity) {
+	if (!IsAlive(entity.GetHandle())) {
+		return;
+	}
+	FlagForKill(entity.GetId());
+}
+
+void Registry::FlagForKill(int entityId) {
+	if (entityId >= static_cast<int>(entitiesPendingKill.size())) {
+		entitiesPendingKill.resize(entityIds.GetHighWaterMark(), false);
+	}
+	if (entitiesPendingKill[entityId]) {
+		return;
+	}
+	entitiesPendingKill[entityId] = true;
+	entitiesToBeKilled.push_back(entityId);
+}
+
+void Registry::RemoveAllComponents(const std::vector<int>& entityIds) {
+	killedEntitiesPerPool.resize(componentPools.size());
+
+	// leave the groups first so the pools can swap-and-pop freely
+	for (auto entityId: entityIds) {
+		ForEachComponent(entityComponentSignatures[entityId], [this, entityId](int componentId) {
+			for (auto& group: groups) {
+				if (group.second->GetSignature().test(componentId)) {
+					group.second->OnComponentRemoved(entityId);
+				}
+			}
+			NotifyObservers(componentId, ComponentEvent::Destroy, entityId);
+			killedEntitiesPerPool[componentId].push_back(entityId);
+		});
+	}
+
+	for (size_t componentId = 0; componentId < componentPools.size(); componentId++) {
+		auto& killed = killedEntitiesPerPool[componentId];
+		if (!killed.empty()) {
+			componentPools[componentId]->RemoveEntities(killed);
+			killed.clear();
+		}
+	}
+}
+
+void Registry::QueueSystemChange(int entityId, const Signature& before) {
+	// staged entities are matched against the final signature by Update
+	if (entityId >= static_cast<int>(entitiesInSystems.size()) || !entitiesInSystems[entityId]) {
+		return;
+	}
+	if (entityId >= static_cast<int>(entitiesPendingReconcile.size())) {
+		entitiesPendingReconcile.resize(entityIds.GetHighWaterMark(), false);
+	}
+	// the first change since the last Update holds what the systems matched
+	if (!entitiesPendingReconcile[entityId]) {
+		entitiesPendingReconcile[entityId] = true;
+		entitiesToReconcile.emplace_back(entityId, before);
+	}
+}
+
+void Registry::ReconcileSystems() {
+	for (const auto& change: entitiesToReconcile) {
+		const auto entityId = change.first;
+		entitiesPendingReconcile[entityId] = false;
+		// killed entities leave every system with the kills
+		if (entityId < static_cast<int>(entitiesPendingKill.size()) && entitiesPendingKill[entityId]) {
+			continue;
+		}
+		const auto& before = change.second;
+		const auto& after = entityComponentSignatures[entityId];
+		const Entity entity(EntityHandle(entityId, entityGenerations[entityId]), this);
+
+		for (auto& system: systems) {
+			const auto& systemComponentSignature = system.second->GetComponentSignature();
+			const bool wasInterested = (before & systemComponentSignature) == systemComponentSignature;
+			const bool isInterested = (after & systemComponentSignature) == systemComponentSignature;
+
+			if (wasInterested && !isInterested) {
+				system.second->RemoveEntityFromSystem(entity);
+			} else if (!wasInterested && isInterested) {
+				system.second->AddEntityToSystem(entity);
+			}
+		}
+	}
+	entitiesToReconcile.clear();
+}
+
+void Registry::CommitAddedComponents(int entityId, const Signature& before, const Signature& added) {
+	entityComponentSignatures[entityId] |= added;
+	const auto& after = entityComponentSignatures[entityId];
+
+	for (auto& group: groups) {
+		if ((group.second->GetSignature() & added).any()) {
+			group.second->OnComponentAdded(entityId, after);
+		}
+	}
+
+	ForEachComponent(added, [this, &before, entityId](int componentId) {
+		NotifyObservers(componentId, before.test(componentId) ? ComponentEvent::Update : ComponentEvent::Construct, entityId);
+	});
+
+	QueueSystemChange(entityId, before);
+}
+
+void Registry::BeginRemovingComponents(int entityId, const Signature& removed) {
+	for (auto& group: groups) {
+		if ((group.second->GetSignature() & removed).any()) {
+			group.second->OnComponentRemoved(entityId);
+		}
+	}
+
+	ForEachComponent(removed, [this, entityId](int componentId) {
+		NotifyObservers(componentId, ComponentEvent::Destroy, entityId);
+	});
+}
+
+void Registry::CommitRemovedComponents(int entityId, const Signature& before, const Signature& removed) {
+	entityComponentSignatures[entityId] &= ~removed;
+	QueueSystemChange(entityId, before);
+}
+
+int Registry::RegisterComponent(const ComponentLayout& layout) {
+	const auto componentId = RuntimeComponent::GetId(layout.GetName());
+	if (componentId >= static_cast<int>(MAX_COMPONENTS)) {
+		LOG_ERROR(ECS, "Too many component types to register " + layout.GetName());
+		return -1;
+	}
+
+	// scripts run again on a level reload, the pool stays as long as the
+	// fields did not change
+	if (componentId < static_cast<int>(componentPools.size()) && componentPools[componentId]) {
+		if (!componentPools[componentId]->IsRuntime()) {
+			LOG_ERROR(ECS, "Component id " + std::to_string(componentId) + " of " + layout.GetName() + " holds a native component");
+			return -1;
+		}
+		// the pool may have come from another registry with MoveEntities
+		runtimeComponents.set(componentId);
+		if (!GetRuntimePool(componentId).GetLayout().SameFields(layout)) {
+			LOG_ERROR(ECS, "Component " + layout.GetName() + " is already registered with other fields");
+		}
+		return componentId;
+	}
+	AddPool(componentId, std::make_shared<ByteColumnPool>(layout));
+	LOG_INFO(ECS, "Registered component " + layout.GetName() + " with id " + std::to_string(componentId));
+	return componentId;
+}
+
+bool Registry::IsRuntimeComponent(int componentId) const {
+	return componentId >= 0 && componentId < static_cast<int>(MAX_COMPONENTS) &&
+		runtimeComponents.test(componentId) &&
+		componentId < static_cast<int>(componentPools.size()) && componentPools[componentId];
+}
+
+ByteColumnPool& Registry::GetRuntimePool(int componentId) const {
+	assert(IsRuntimeComponent(componentId) && "not a runtime component id");
+	return *std::static_pointer_cast<ByteColumnPool>(componentPools[componentId]);
+}
+
+void Registry::AddComponent(Entity entity, int componentId) {
+	if (!IsRuntimeComponent(componentId)) {
+		LOG_ERROR(ECS, "AddComponent: " + std::to_string(componentId) + " is not a runtime component id");
+		return;
+	}
+	const auto entityId = entity.GetId();
+	Signature added;
+	added.set(componentId);
+
+	const auto before = entityComponentSignatures[entityId];
+	GetRuntimePool(componentId).Add(entityId);
+	CommitAddedComponents(entityId, before, added);
+}
+
+void Registry::RemoveComponent(Entity entity, int componentId) {
+	if (!IsRuntimeComponent(componentId)) {
+		LOG_ERROR(ECS, "RemoveComponent: " + std::to_string(componentId) + " is not a runtime component id");
+		return;
+	}
+	if (!HasComponent(entity, componentId)) {
+		return;
+	}
+	const auto entityId = entity.GetId();
+	Signature removed;
+	removed.set(componentId);
+
+	const auto before = entityComponentSignatures[entityId];
+	BeginRemovingComponents(entityId, removed);
+	GetRuntimePool(componentId).Remove(entityId);
+	CommitRemovedComponents(entityId, before, removed);
+}
+
+bool Registry::HasComponent(Entity entity, int componentId) const {
+	if (!IsRuntimeComponent(componentId)) {
+		return false;
+	}
+	return entityComponentSignatures[entity.GetId()].test(componentId);
+}
+
 // Adds an entity that has the required components to the system 
 void Registry::AddEntityToSystems(Entity entity) {
 	const auto entityId = entity.GetId(); 
 
+	if (entityId >= static_cast<int>(entitiesInSystems.size())) {
+		entitiesInSystems.resize(entityIds.GetHighWaterMark(), false);
+	}
+	entitiesInSystems[entityId] = true;
+
 	const auto entityComponentSignature = entityComponentSignatures[entityId];
 	
 	for(auto& system: systems) {
@@ -67,14 +398,327 @@ void Registry::AddEntityToSystems(Entity entity) {
 
 }
 
+void Registry::AddEntitiesToSystems(const int* entityIds, size_t count) {
+	const auto entityComponentSignature = entityComponentSignatures[entityIds[0]];
+
+	if (entitiesInSystems.size() < static_cast<size_t>(this->entityIds.GetHighWaterMark())) {
+		entitiesInSystems.resize(this->entityIds.GetHighWaterMark(), false);
+	}
+
+	systemBatch.clear();
+	for (size_t i = 0; i < count; i++) {
+		systemBatch.emplace_back(entityIds[i], entityGenerations[entityIds[i]]);
+		entitiesInSystems[entityIds[i]] = true;
+	}
+
+	for (auto& system: systems) {
+		const auto& systemComponentSignature = system.second->GetComponentSignature();
+		if ((entityComponentSignature & systemComponentSignature) == systemComponentSignature) {
+			system.second->AddEntitiesToSystem(systemBatch);
+		}
+	}
+}
+
+void Registry::AddPool(int componentId, std::shared_ptr<IPool> pool) {
+	if (componentId >= static_cast<int>(componentPools.size())) {
+		componentPools.resize(componentId + 1, nullptr);
+	}
+	if (pool->IsDoubleBuffered()) {
+		doubleBufferedPools.push_back(pool.get());
+	}
+	runtimeComponents.set(componentId, pool->IsRuntime());
+	componentPools[componentId] = std::move(pool);
+}
+
+void Registry::NotifyObservers(int componentId, ComponentEvent event, int entityId) {
+	if (componentId >= static_cast<int>(componentObservers.size())) {
+		return;
+	}
+	for (auto& observer: componentObservers[componentId]) {
+		if (!observer->removed) {
+			observer->Push(event, entityId);
+		}
+	}
+}
+
+void Registry::RemoveObserver(const std::shared_ptr<Observer>& observer) {
+	observer->removed = true;
+	observer->Discard();
+	if (deliveringObservers) {
+		observersRemovedDuringDelivery = true;
+		return;
+	}
+	auto& observers = componentObservers[observer->GetComponentId()];
+	observers.erase(std::remove(observers.begin(), observers.end(), observer), observers.end());
+}
+
+void Registry::Clear() {
+	entitiesToBeAdded.Clear();
+	stagedEntities.clear();
+	entitiesToBeKilled.clear();
+	std::fill(entitiesPendingKill.begin(), entitiesPendingKill.end(), false);
+	std::fill(entitiesInSystems.begin(), entitiesInSystems.end(), false);
+	entitiesToReconcile.clear();
+	std::fill(entitiesPendingReconcile.begin(), entitiesPendingReconcile.end(), false);
+
+	for (auto& pool: componentPools) {
+		if (pool) {
+			pool->Clear();
+		}
+	}
+	for (auto& group: groups) {
+		group.second->Clear();
+	}
+	for (auto& system: systems) {
+		system.second->ClearEntities();
+	}
+	for (auto& observers: componentObservers) {
+		for (auto& observer: observers) {
+			observer->Discard();
+		}
+	}
+
+	// Signatures are left as they are, CreateEntity resets them when an id is
+	// handed out again. Every id is recycled, so handles from before go stale.
+	const auto highWaterMark = entityIds.GetHighWaterMark();
+	for (int entityId = 0; entityId < highWaterMark; entityId++) {
+		entityGenerations[entityId]++;
+	}
+	entityIds.Reset();
+}
+
+void Registry::Reserve(int entityCount) {
+	entityIds.Reserve(entityCount);
+	entitiesToBeAdded.Reserve(entityCount);
+	entityComponentSignatures.Reserve(entityCount);
+	entityGenerations.Reserve(entityCount);
+	stagedEntities.reserve(entityCount);
+	systemBatch.reserve(entityCount);
+	entitiesPendingKill.reserve(entityCount);
+	entitiesInSystems.reserve(entityCount);
+	entitiesPendingReconcile.reserve(entityCount);
+
+	for (auto& pool: componentPools) {
+		if (pool) {
+			pool->Reserve(entityCount);
+		}
+	}
+	for (auto& system: systems) {
+		system.second->ReserveEntities(entityCount);
+	}
+}
+
+void Registry::Compact(double budgetMilliseconds) {
+	PROFILE_ZONE("Registry::Compact");
+	if (componentPools.empty()) {
+		return;
+	}
+	const auto start = std::chrono::steady_clock::now();
+	double elapsedMilliseconds = 0.0;
+
+	// a pool is compacted a step at a time so a large one is spread over
+	// several calls; the cursor stays on it until a step finishes with budget
+	// left
+	for (size_t visited = 0; visited < componentPools.size() && elapsedMilliseconds < budgetMilliseconds; ) {
+		compactionCursor %= componentPools.size();
+		auto slotBudget = COMPACTION_STEP_SLOTS;
+		if (auto& pool = componentPools[compactionCursor]) {
+			stats.compactionBytesReclaimed += pool->Compact(slotBudget);
+		}
+		if (slotBudget > 0) {
+			compactionCursor++;
+			visited++;
+		}
+		if (slotBudget < COMPACTION_STEP_SLOTS) {
+			elapsedMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+	}
+	elapsedMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	stats.lastCompactionMilliseconds = elapsedMilliseconds;
+	stats.compactionMilliseconds += elapsedMilliseconds;
+}
+
+size_t Registry::MemoryUsage() const {
+	size_t bytes = 0;
+	for (auto& pool: componentPools) {
+		if (pool) {
+			bytes += pool->MemoryUsage();
+		}
+	}
+	return bytes;
+}
+
+void Registry::SwapBuffers() {
+	PROFILE_ZONE("Registry::SwapBuffers");
+	for (auto pool: doubleBufferedPools) {
+		pool->SwapBuffers();
+	}
+}
+
 void Registry::Update() {
+	PROFILE_ZONE("Registry::Update");
+
+	entitiesToBeAdded.TakeAll(stagedEntities);
+
+	// Membership changes of the components added and removed since the last
+	// Update, before the kills so the killed ones can be told apart
+	ReconcileSystems();
 
-	// Add the entities that are waiting to be create to the active Systems
-	for (auto entity: entitiesToBeAdded) {
-		AddEntityToSystems(entity);
+	// Remove the entities that are waiting to be killed from the active systems,
+	// one pass per system, then free their components and recycle their ids
+	if (!entitiesToBeKilled.empty()) {
+		for (auto& system: systems) {
+			system.second->RemoveKilledEntities(entitiesPendingKill);
+		}
+		RemoveAllComponents(entitiesToBeKilled);
+		for (auto entityId: entitiesToBeKilled) {
+			entityComponentSignatures[entityId].reset();
+			entityGenerations[entityId]++;
+			if (entityId < static_cast<int>(entitiesInSystems.size())) {
+				entitiesInSystems[entityId] = false;
+			}
+			entityIds.Release(entityId);
+		}
+
+		// entities killed in the frame they were created never reach the systems
+		stagedEntities.erase(std::remove_if(stagedEntities.begin(), stagedEntities.end(),
+							[this](int entityId) {
+								return entityId < static_cast<int>(entitiesPendingKill.size()) && entitiesPendingKill[entityId];
+							}), stagedEntities.end());
+
+		for (auto entityId: entitiesToBeKilled) {
+			entitiesPendingKill[entityId] = false;
+		}
+		entitiesToBeKilled.clear();
+	}
+
+	// Add the entities that are waiting to be created to the active Systems.
+	// Sorting by signature groups entities that go to the same systems, so each
+	// run is matched once and appended to the systems in a single insert.
+	std::sort(stagedEntities.begin(), stagedEntities.end(), [this](int a, int b) {
+		const auto signatureA = entityComponentSignatures[a].to_ulong();
+		const auto signatureB = entityComponentSignatures[b].to_ulong();
+		return signatureA != signatureB ? signatureA < signatureB : a < b;
+	});
+
+	for (size_t first = 0; first < stagedEntities.size();) {
+		const auto& signature = entityComponentSignatures[stagedEntities[first]];
+		size_t last = first + 1;
+		while (last < stagedEntities.size() && entityComponentSignatures[stagedEntities[last]] == signature) {
+			last++;
+		}
+		AddEntitiesToSystems(&stagedEntities[first], last - first);
+		first = last;
+	}
+
+	stagedEntities.clear();
+
+	// Hand the component events collected since the last Update to the observers.
+	// Indexed loops and a local copy, handlers may add observers; removals
+	// are deferred until the loop is done, see RemoveObserver.
+	deliveringObservers = true;
+	for (size_t componentId = 0; componentId < componentObservers.size(); componentId++) {
+		for (size_t i = 0; i < componentObservers[componentId].size(); i++) {
+			auto observer = componentObservers[componentId][i];
+			if (!observer->removed) {
+				observer->Deliver();
+			}
+		}
+	}
+	deliveringObservers = false;
+	if (observersRemovedDuringDelivery) {
+		for (auto& observers: componentObservers) {
+			observers.erase(std::remove_if(observers.begin(), observers.end(),
+				[](const std::shared_ptr<Observer>& observer) { return observer->removed; }), observers.end());
+		}
+		observersRemovedDuringDelivery = false;
+	}
+
+}
+
+std::vector<Entity> MoveEntities(const std::vector<Entity>& batch, Registry& from, Registry& to) {
+	std::vector<int> sourceIds;
+	std::vector<int> destinationIds;
+	std::vector<Entity> moved;
+	sourceIds.reserve(batch.size());
+	destinationIds.reserve(batch.size());
+	moved.reserve(batch.size());
+
+	// Every component type any of the moved entities has
+	Signature batchSignature;
+	for (auto entity: batch) {
+		const auto entityId = entity.GetId();
+		// a stale or recycled handle would move whatever now owns the id
+		if (!from.IsAlive(entity.GetHandle())) {
+			LOG_WARN(ECS, "MoveEntities skipped a stale handle for entity id " + std::to_string(entityId));
+			continue;
+		}
+		// already killed, or listed twice in the batch
+		if (entityId < static_cast<int>(from.entitiesPendingKill.size()) && from.entitiesPendingKill[entityId]) {
+			continue;
+		}
+		const auto signature = from.entityComponentSignatures[entityId];
+		batchSignature |= signature;
+
+		// leave the source groups first so the pools can swap-and-pop freely
+		ForEachComponent(signature, [&from, entityId](int componentId) {
+			for (auto& group: from.groups) {
+				if (group.second->GetSignature().test(componentId)) {
+					group.second->OnComponentRemoved(entityId);
+				}
+			}
+			from.NotifyObservers(componentId, ComponentEvent::Destroy, entityId);
+		});
+
+		Entity destination = to.CreateEntity();
+		to.entityComponentSignatures[destination.GetId()] = signature;
+		sourceIds.push_back(entityId);
+		destinationIds.push_back(destination.GetId());
+		moved.push_back(destination);
+
+		// The source entity is now empty: flag it as killed so its id is
+		// recycled on the next Update
+		from.entityComponentSignatures[entityId].reset();
+		from.FlagForKill(entityId);
 	}
 
-	entitiesToBeAdded.clear();
-// Remove the entities that are waiting to be killed from the active systems 
+	// Column by column
+	for (size_t componentId = 0; componentId < from.componentPools.size(); componentId++) {
+		if (!batchSignature.test(componentId)) {
+			continue;
+		}
+		auto& sourcePool = from.componentPools[componentId];
+		if (componentId >= to.componentPools.size() || !to.componentPools[componentId]) {
+			to.AddPool(static_cast<int>(componentId), sourcePool->CreateEmpty());
+		}
+		sourcePool->MoveEntitiesTo(*to.componentPools[componentId], sourceIds, destinationIds);
+	}
+
+	for (auto entityId: destinationIds) {
+		auto& signature = to.entityComponentSignatures[entityId];
+		// a singleton the destination already had on another entity was
+		// dropped, the entity must not claim it
+		ForEachComponent(Signature(signature), [&to, &signature, entityId](int componentId) {
+			if (!to.componentPools[componentId]->CanAdd(entityId)) {
+				LOG_ERROR(ECS, "MoveEntities dropped singleton component id " + std::to_string(componentId) + ", the destination already has one");
+				signature.reset(componentId);
+			}
+		});
+		ForEachComponent(signature, [&to, &signature, entityId](int componentId) {
+			for (auto& group: to.groups) {
+				if (group.second->GetSignature().test(componentId)) {
+					group.second->OnComponentAdded(entityId, signature);
+				}
+			}
+			to.NotifyObservers(componentId, ComponentEvent::Construct, entityId);
+		});
+	}
+
+	// pull the moved entities out of the source systems right away
+	for (auto& system: from.systems) {
+		system.second->RemoveKilledEntities(from.entitiesPendingKill);
+	}
 
+	return moved;
 }
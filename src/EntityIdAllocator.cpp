@@ -0,0 +1,120 @@
+#include "ECS/EntityIdAllocator.h"
+#include "Logger/Logger.h"
+
+#include <cassert>
+
+namespace {
+
+const uint64_t ID_MASK = 0xffffffffull;
+
+uint64_t NextTag(uint64_t head) {
+	return ((head >> 32) + 1) << 32;
+}
+
+// A thread keeps a few ranges so it can alternate between registries without
+// reserving a new range each time. An evicted range's unused ids are lost.
+struct IdRange {
+	uint64_t allocator = 0;
+	uint32_t epoch = 0;
+	int next = 0;
+	int end = 0;
+};
+
+const int CACHED_RANGES = 4;
+thread_local IdRange ranges[CACHED_RANGES];
+thread_local int nextEvicted = 0;
+
+std::atomic<uint64_t> nextInstanceId{1};
+
+}
+
+void ConcurrentIdStack::Push(int id) {
+	next.EnsurePage(id);
+
+	uint64_t oldHead = head.load(std::memory_order_relaxed);
+	uint64_t newHead;
+	do {
+		next[id].store(static_cast<int>(oldHead & ID_MASK) - 1, std::memory_order_relaxed);
+		newHead = (oldHead & ~ID_MASK) | static_cast<uint32_t>(id + 1);
+	} while (!head.compare_exchange_weak(oldHead, newHead, std::memory_order_release, std::memory_order_relaxed));
+}
+
+int ConcurrentIdStack::Pop() {
+	uint64_t oldHead = head.load(std::memory_order_acquire);
+	while ((oldHead & ID_MASK) != 0) {
+		const int id = static_cast<int>(oldHead & ID_MASK) - 1;
+		const int below = next[id].load(std::memory_order_relaxed);
+		const uint64_t newHead = NextTag(oldHead) | static_cast<uint32_t>(below + 1);
+		if (head.compare_exchange_weak(oldHead, newHead, std::memory_order_acquire, std::memory_order_acquire)) {
+			return id;
+		}
+	}
+	return -1;
+}
+
+void ConcurrentIdStack::TakeAll(std::vector<int>& ids) {
+	uint64_t oldHead = head.load(std::memory_order_acquire);
+	while (!head.compare_exchange_weak(oldHead, NextTag(oldHead), std::memory_order_acquire, std::memory_order_acquire)) {
+	}
+	// the detached list is private to us now
+	for (int id = static_cast<int>(oldHead & ID_MASK) - 1; id != -1; id = next[id].load(std::memory_order_relaxed)) {
+		ids.push_back(id);
+	}
+}
+
+void ConcurrentIdStack::Clear() {
+	head.store(NextTag(head.load(std::memory_order_relaxed)), std::memory_order_release);
+}
+
+EntityIdAllocator::EntityIdAllocator()
+	: instanceId(nextInstanceId.fetch_add(1, std::memory_order_relaxed)) {
+}
+
+int EntityIdAllocator::Allocate() {
+	const int recycledId = freeIds.Pop();
+	if (recycledId != -1) {
+		return recycledId;
+	}
+
+	const auto currentEpoch = epoch.load(std::memory_order_acquire);
+
+	IdRange* range = nullptr;
+	for (auto& cached: ranges) {
+		if (cached.allocator == instanceId) {
+			range = &cached;
+			break;
+		}
+	}
+	if (!range) {
+		range = &ranges[nextEvicted];
+		nextEvicted = (nextEvicted + 1) % CACHED_RANGES;
+	}
+	// a range reserved before a Reset overlaps the ids being handed out again
+	if (range->allocator != instanceId || range->epoch != currentEpoch) {
+		*range = IdRange();
+		range->allocator = instanceId;
+		range->epoch = currentEpoch;
+	}
+
+	if (range->next == range->end) {
+		const int begin = nextId.fetch_add(RANGE_SIZE, std::memory_order_acq_rel);
+		if (begin + RANGE_SIZE > MAX_ENTITIES) {
+			LOG_ERROR(ECS, "Out of entity ids");
+		}
+		assert(begin + RANGE_SIZE <= MAX_ENTITIES && "entity id space exhausted");
+		range->next = begin;
+		range->end = begin + RANGE_SIZE;
+	}
+
+	return range->next++;
+}
+
+void EntityIdAllocator::Release(int id) {
+	freeIds.Push(id);
+}
+
+void EntityIdAllocator::Reset() {
+	freeIds.Clear();
+	nextId.store(0, std::memory_order_release);
+	epoch.fetch_add(1, std::memory_order_acq_rel);
+}
@@ -0,0 +1,110 @@
+#include "Game/FrameTimer.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace {
+
+// sleeps timed at construction to seed the margin
+const int CALIBRATION_SLEEPS = 5;
+// weight of the newest oversleep in the moving average
+const double OVERSLEEP_SMOOTHING = 0.1;
+// the margin covers this many standard deviations above the mean oversleep
+const double MARGIN_DEVIATIONS = 3.0;
+const double MIN_SLEEP_MARGIN = 0.0002;
+// beyond this the platform timer is too coarse to bother sleeping near the deadline
+const double MAX_SLEEP_MARGIN = 0.02;
+
+double Seconds(FrameTimer::Clock::duration duration) {
+	return std::chrono::duration<double>(duration).count();
+}
+
+}
+
+FrameTimer::FrameTimer() {
+	// the first samples replace the average outright
+	oversleepMean = -1.0;
+	for (int i = 0; i < CALIBRATION_SLEEPS; i++) {
+		SleepUntil(Clock::now() + std::chrono::milliseconds(1));
+	}
+	Start();
+}
+
+void FrameTimer::SleepUntil(Clock::time_point wakeTime) {
+	std::this_thread::sleep_until(wakeTime);
+	const double oversleep = std::max(0.0, Seconds(Clock::now() - wakeTime));
+
+	if (oversleepMean < 0.0) {
+		oversleepMean = oversleep;
+		oversleepVariance = 0.0;
+	} else {
+		const double difference = oversleep - oversleepMean;
+		oversleepMean += OVERSLEEP_SMOOTHING * difference;
+		oversleepVariance = (1.0 - OVERSLEEP_SMOOTHING) * (oversleepVariance + OVERSLEEP_SMOOTHING * difference * difference);
+	}
+	sleepMargin = std::clamp(oversleepMean + MARGIN_DEVIATIONS * std::sqrt(oversleepVariance), MIN_SLEEP_MARGIN, MAX_SLEEP_MARGIN);
+	stats.sleepMarginMs = sleepMargin * 1000.0;
+}
+
+void FrameTimer::Start() {
+	frameStart = Clock::now();
+	deadline = frameStart;
+	paced = false;
+}
+
+double FrameTimer::Tick() {
+	const auto now = Clock::now();
+	const double frameTime = Seconds(now - frameStart);
+	frameStart = now;
+	UpdateStats(frameTime);
+	return frameTime;
+}
+
+void FrameTimer::WaitForNextFrame(double period) {
+	const auto step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(period));
+	const auto now = Clock::now();
+	deadline = paced ? deadline + step : frameStart + step;
+	paced = true;
+	// more than a frame behind: start over from now rather than rushing
+	// through frames to catch up
+	if (deadline + step < now) {
+		deadline = now;
+		return;
+	}
+
+	const auto sleepEnd = deadline - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(sleepMargin));
+	if (sleepEnd > now) {
+		SleepUntil(sleepEnd);
+	}
+	while (Clock::now() < deadline) {
+	}
+}
+
+void FrameTimer::UpdateStats(double frameTime) {
+	samples[nextSample] = frameTime;
+	nextSample = (nextSample + 1) % FRAME_TIME_SAMPLES;
+	sampleCount = std::min(sampleCount + 1, FRAME_TIME_SAMPLES);
+
+	double sum = 0.0;
+	double minimum = samples[0];
+	double maximum = samples[0];
+	for (size_t i = 0; i < sampleCount; i++) {
+		sum += samples[i];
+		minimum = std::min(minimum, samples[i]);
+		maximum = std::max(maximum, samples[i]);
+	}
+	const double mean = sum / sampleCount;
+	double squares = 0.0;
+	for (size_t i = 0; i < sampleCount; i++) {
+		squares += (samples[i] - mean) * (samples[i] - mean);
+	}
+	const double variance = squares / sampleCount;
+
+	stats.frames++;
+	stats.lastFrameMs = frameTime * 1000.0;
+	stats.meanFrameMs = mean * 1000.0;
+	stats.frameVarianceMs2 = variance * 1000.0 * 1000.0;
+	stats.frameStdDevMs = std::sqrt(variance) * 1000.0;
+	stats.minFrameMs = minimum * 1000.0;
+	stats.maxFrameMs = maximum * 1000.0;
+}
@@ -1,30 +1,43 @@
 #include <SDL.h>
 #include <SDL_image.h>
 #include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <thread>
 
 #include "ECS/ECS.h"
 #include "Game/Game.h"
+#include "Logger/BinaryLog.h"
 #include "Logger/Logger.h"
+#include "Profiler/Profiler.h"
 #include "Systems/MovementSystem.h"
 #include "Components/TransformComponent.h"
 #include "Components/RigidBodyComponent.h"
 #include "Components/SpriteComponent.h"
 #include "Systems/MovementSystem.h"
 #include "Systems/RenderSystem.h"
+#include "Scripting/ScriptComponents.h"
 
 Game::Game() {
 	isRunning = false;
 	registry = std::make_unique<Registry>(); 
-	Logger::Log("Game constructor called!");
+	LOG_INFO(CORE, "Game constructor called!");
 }
 
-Game::~Game() { Logger::Log("Game destructor called"); }
+Game::~Game() { LOG_INFO(CORE, "Game destructor called"); }
 
 void Game::Initialize() {
+	// the simulation needs nothing from SDL, only video, audio and input do
+	if (headless) {
+		isRunning = true;
+		return;
+	}
+
 	if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
-		Logger::Err("Error initializing SDL");
+		LOG_ERROR(RENDER, "Error initializing SDL");
 		return;
 	}
 	// get the display mode from the system, setting it to full
@@ -40,104 +53,324 @@ void Game::Initialize() {
 		windowWidth, windowHeight, 0);
 
 	if (!window) {
-		Logger::Err("Error creating SDL window.");
+		LOG_ERROR(RENDER, "Error creating SDL window.");
 		return;
 	}
 
 	
-	renderer = SDL_CreateRenderer(window, -1, 0);
+	// the simulation runs at a fixed rate whatever the frame rate, so the
+	// renderer is free to follow the display or run uncapped
+	renderer = SDL_CreateRenderer(window, -1, vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
 	if (!renderer) {
-		Logger::Err("Error creating SDL Renderer");
+		LOG_ERROR(RENDER, "Error creating SDL Renderer");
 		return;
 	}
+	// drivers may ignore the vsync request, the frame cap takes over then
+	SDL_RendererInfo rendererInfo;
+	vsyncActive = vsync && SDL_GetRendererInfo(renderer, &rendererInfo) == 0 &&
+		(rendererInfo.flags & SDL_RENDERER_PRESENTVSYNC);
+	if (vsync && !vsyncActive) {
+		LOG_WARN(RENDER, "Vsync is not available, capping at " + std::to_string(targetFrameRate) + " fps");
+	}
 	// If you want fake full screen
 	// SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN); 
 	isRunning = true;
 }
 
 void Game::Setup() {
+	// structured events of this run, render with logdecoder session.plog
+	BinaryLog::Open("./session.plog");
+
+	// input is tied to steps, so a replay needs the steps it was recorded with
+	if (!replayPath.empty() && inputPlayer.Open(replayPath)) {
+		SetTickRate(inputPlayer.GetTickRate());
+		replaying = true;
+	}
+	if (!recordPath.empty()) {
+		inputRecorder.Open(recordPath, tickRate);
+	}
 
 	registry->AddSystem<MovementSystem>();
 	registry->AddSystem<RenderSystem>();
 
+	lua.open_libraries(sol::lib::base, sol::lib::math);
+	BindScriptComponents(lua, *registry);
+
+	LoadLevel(1);
+}
+
+void Game::LoadLevel(int level) {
+	// Reuse the registry: systems, pools and their capacity survive the reload
+	registry->Clear();
+	registry->Reserve(2);
+
+	LOG_INFO(ASSET, "Loading level " + std::to_string(level));
+
 	Entity tank = registry->CreateEntity();
 
-	tank.AddComponent<TransformComponent>(glm::vec2(10.0, 30.0), glm::vec2(1.0, 1.0), 0.0); 
-	tank.AddComponent<RigidBodyComponent>(glm::vec2(40.0, 0.0)); 
-	tank.AddComponent<SpriteComponent>(10, 10);
+	tank.AddComponents<TransformComponent, RigidBodyComponent, SpriteComponent>(
+		TransformComponent(glm::vec2(10.0, 30.0), glm::vec2(1.0, 1.0), 0.0),
+		RigidBodyComponent(glm::vec2(40.0, 0.0)),
+		SpriteComponent(10, 10));
 
 	Entity truck = registry->CreateEntity();
 
-	truck.AddComponent<TransformComponent>(glm::vec2(50.0, 100.0), glm::vec2(1.0, 1.0), 0.0); 
-	truck.AddComponent<RigidBodyComponent>(glm::vec2(0.0, 50.0)); 
-	truck.AddComponent<SpriteComponent>(10, 50);
+	truck.AddComponents<TransformComponent, RigidBodyComponent, SpriteComponent>(
+		TransformComponent(glm::vec2(50.0, 100.0), glm::vec2(1.0, 1.0), 0.0),
+		RigidBodyComponent(glm::vec2(0.0, 50.0)),
+		SpriteComponent(10, 50));
 
+	// optional per level script, may define components and an update(deltaTime)
+	const std::string script = "./assets/scripts/Level" + std::to_string(level) + ".lua";
+	if (std::ifstream(script).good()) {
+		sol::protected_function_result result = lua.safe_script_file(script, &sol::script_pass_on_error);
+		if (!result.valid()) {
+			sol::error error = result;
+			LOG_ERROR(SCRIPT, std::string("Error loading ") + script + ": " + error.what());
+		}
+	}
+}
 
+void Game::SetTickRate(int ticksPerSecond) {
+	if (ticksPerSecond <= 0) {
+		LOG_ERROR(CORE, "Invalid tick rate " + std::to_string(ticksPerSecond));
+		return;
+	}
+	tickRate = ticksPerSecond;
+	fixedDeltaTime = 1.0 / ticksPerSecond;
 }
 
+/**
+ * Serially each frame is input, simulation, render. Pipelined, the simulation
+ * runs on its own thread and this one (which owns the window and renderer)
+ * handles input and draws: frame N is submitted while frame N+1 is simulated,
+ * so a frame costs the longer of the two rather than their sum.
+ */
 void Game::Run() {
+	Profiler::SetThreadName("Main");
 	Setup();
+	frameTimer.Start();
+
+	if (headless) {
+		RunHeadless();
+		return;
+	}
+
+	if (!pipelined) {
+		while (isRunning) {
+			ProcessInput();
+			Update();
+			BuildRenderPacket(renderPackets.GetWriteBuffer());
+			renderPackets.Publish();
+			renderPackets.Acquire();
+			Render(renderPackets.GetReadBuffer());
+			if (targetFrameRate > 0 && !vsyncActive) {
+				frameTimer.WaitForNextFrame(1.0 / targetFrameRate);
+			}
+		}
+		return;
+	}
+
+	std::thread simulation(&Game::RunSimulation, this);
 	while (isRunning) {
 		ProcessInput();
+		if (!renderPackets.Acquire()) {
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+			continue;
+		}
+		Render(renderPackets.GetReadBuffer());
+	}
+	simulation.join();
+}
+
+/**
+ * One step per frame with no waiting, so a run of N frames simulates the
+ * same N steps on any machine however long they take
+ */
+void Game::RunHeadless() {
+	const auto start = FrameTimer::Clock::now();
+	double elapsed = 0.0;
+	uint64_t frames = 0;
+	while (isRunning && (frameLimit == 0 || frames < frameLimit) && (secondsLimit <= 0.0 || elapsed < secondsLimit)) {
+		frameTimer.Tick();
+		Step();
+		BinaryLog::Flush();
+		frames++;
+		elapsed = std::chrono::duration<double>(FrameTimer::Clock::now() - start).count();
+	}
+
+	// plain stdout, for the scripts that track these numbers
+	const auto& stats = frameTimer.GetStats();
+	std::printf("headless: %llu frames in %.3f s, %.1f frames/s, %.4f ms mean, %.4f ms deviation, %.4f to %.4f ms\n",
+		static_cast<unsigned long long>(frames), elapsed, elapsed > 0.0 ? frames / elapsed : 0.0,
+		stats.meanFrameMs, stats.frameStdDevMs, stats.minFrameMs, stats.maxFrameMs);
+	isRunning = false;
+}
+
+void Game::RunSimulation() {
+	Profiler::SetThreadName("Simulation");
+	while (isRunning) {
 		Update();
-		Render();
+		BuildRenderPacket(renderPackets.GetWriteBuffer());
+		renderPackets.Publish();
+
+		// stay one frame ahead of the render stage: wait until it takes this
+		// packet, then simulate the next while it draws
+		while (isRunning && renderPackets.HasUnread()) {
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+		if (targetFrameRate > 0 && !vsyncActive) {
+			frameTimer.WaitForNextFrame(1.0 / targetFrameRate);
+		}
 	}
 }
 
 void Game::ProcessInput() {
+	PROFILE_ZONE("Game::ProcessInput");
 
 	SDL_Event sdlEvent;
 	while (SDL_PollEvent(&sdlEvent)) {
-		switch (sdlEvent.type) {
-		case SDL_QUIT:
-			isRunning = false;
-			break;
-		case SDL_KEYDOWN:
-			if (sdlEvent.key.keysym.sym == SDLK_ESCAPE) {
+		// F9 saves the last seconds of profiler zones, it is not game input
+		if (sdlEvent.type == SDL_KEYDOWN && sdlEvent.key.keysym.sym == SDLK_F9 && !sdlEvent.key.repeat) {
+			Profiler::ExportChromeTrace(PROFILE_EXPORT_PATH, PROFILE_EXPORT_SECONDS);
+			continue;
+		}
+		if (!InputRecorder::IsRecordable(sdlEvent)) {
+			continue;
+		}
+		// a replay ignores live input, but the window can still be closed
+		if (replaying) {
+			if (sdlEvent.type == SDL_QUIT || (sdlEvent.type == SDL_KEYDOWN && sdlEvent.key.keysym.sym == SDLK_ESCAPE)) {
 				isRunning = false;
 			}
-			break;
+			continue;
+		}
+		std::lock_guard<std::mutex> lock(inputMutex);
+		pendingInput.push_back(sdlEvent);
+	}
+}
+
+void Game::HandleInput(const SDL_Event& event) {
+	switch (event.type) {
+	case SDL_QUIT:
+		isRunning = false;
+		break;
+	case SDL_KEYDOWN:
+		if (event.key.keysym.sym == SDLK_ESCAPE) {
+			isRunning = false;
 		}
+		break;
 	}
 }
 
 void Game::Update() {
-	// if we are too fast , release execution until we reach the
-	// MILLISECS_PER_FRAME
-	int timeToWait = MILLISECS_PER_FRAME - (SDL_GetTicks() - millisecsPreviousFrame);
+	PROFILE_ZONE("Game::Update");
+	const double frameTime = frameTimer.Tick();
+
+	accumulator += std::min(frameTime, MAX_FRAME_TIME);
+	while (accumulator >= fixedDeltaTime) {
+		Step();
+		accumulator -= fixedDeltaTime;
+	}
 
-	if (timeToWait > 0 && timeToWait <= MILLISECS_PER_FRAME) {
-		SDL_Delay(timeToWait);
+	secondsSinceStatsReport += frameTime;
+	if (secondsSinceStatsReport >= 1.0) {
+		[[maybe_unused]] const auto& stats = frameTimer.GetStats();
+		LOG_DEBUG(CORE, "Frame " + std::to_string(stats.meanFrameMs) + " ms mean, " +
+			std::to_string(stats.frameStdDevMs) + " ms deviation, " + std::to_string(stats.minFrameMs) + " to " +
+			std::to_string(stats.maxFrameMs) + " ms, sleep margin " + std::to_string(stats.sleepMarginMs) + " ms");
+		secondsSinceStatsReport = 0.0;
 	}
 
-	// the difference in ticks since the last frame, converted to seconds
-	double deltaTime = (SDL_GetTicks() - millisecsPreviousFrame) / 1000.0;
+	// hand this frame's events to the file so a crash loses at most one frame
+	BinaryLog::Flush();
+}
+
+void Game::Step() {
+	PROFILE_ZONE("Game::Step");
+	// input is handled at step boundaries only, so recording the step with
+	// each event is enough to replay a session exactly
+	stepInput.clear();
+	if (replaying) {
+		SDL_Event event;
+		while (inputPlayer.Next(ticks, event)) {
+			stepInput.push_back(event);
+		}
+	} else {
+		std::lock_guard<std::mutex> lock(inputMutex);
+		stepInput.swap(pendingInput);
+	}
+	for (const auto& event: stepInput) {
+		inputRecorder.Record(ticks, event);
+		HandleInput(event);
+	}
+	ticks++;
 
-	// store the "previous" frame time
-	millisecsPreviousFrame = SDL_GetTicks();
+	// publish the last step before writing the next, the renderer
+	// interpolates between the two
+	registry->SwapBuffers();
 
 	registry->Update();
 
-	registry->GetSystem<MovementSystem>().Update(deltaTime);
+	registry->UpdateSystem<MovementSystem>(fixedDeltaTime);
+
 	// registry->GetSystem<MovementSystem>().Update();
 	// CollisionSystem.Update();
 	// DamageSystem.Update();
 
+	// the level script's update, if it defines one
+	sol::protected_function scriptUpdate = lua["update"];
+	if (scriptUpdate.valid()) {
+		PROFILE_ZONE("Lua update");
+		sol::protected_function_result result = scriptUpdate(fixedDeltaTime);
+		if (!result.valid()) {
+			sol::error error = result;
+			LOG_ERROR(SCRIPT, std::string("Script error: ") + error.what());
+		}
+	}
 
+	// give back pool memory left over from churn, the second between passes
+	// is the window for each pool's peak size
+	if (++ticksSinceCompaction >= tickRate) {
+		registry->Compact(COMPACTION_BUDGET_MS);
+		ticksSinceCompaction = 0;
+	}
 }
 
 void Game::Destroy() {
+	if (!profileExportPath.empty()) {
+		Profiler::ExportChromeTrace(profileExportPath);
+	}
+	BinaryLog::Close();
+	inputRecorder.Close();
+	if (headless) {
+		return;
+	}
 	SDL_DestroyRenderer(renderer);
 	SDL_DestroyWindow(window);
 	SDL_Quit();
 }
 
-void Game::Render() {
-	SDL_SetRenderDrawColor(renderer, 21, 21, 21, 255);
+void Game::BuildRenderPacket(RenderPacket& packet) {
+	PROFILE_ZONE("Game::BuildRenderPacket");
+	packet.Clear();
+	packet.frame = framesSimulated++;
+	// how far between the last two steps the present is
+	const double alpha = accumulator / fixedDeltaTime;
+	registry->UpdateSystem<RenderSystem>(packet, alpha);
+}
+
+void Game::Render(const RenderPacket& packet) {
+	PROFILE_ZONE("Game::Render");
+	SDL_SetRenderDrawColor(renderer, packet.clearColor[0], packet.clearColor[1], packet.clearColor[2], packet.clearColor[3]);
 	SDL_RenderClear(renderer);
 
-	// TODO: Render game object
-	registry->GetSystem<RenderSystem>().Update(renderer); 
+	for (const auto& command: packet.commands) {
+		const SDL_Rect rect = { command.x, command.y, command.width, command.height };
+		SDL_SetRenderDrawColor(renderer, command.r, command.g, command.b, command.a);
+		SDL_RenderFillRect(renderer, &rect);
+	}
 
+	PROFILE_ZONE("SDL_RenderPresent");
 	SDL_RenderPresent(renderer);
 }
@@ -0,0 +1,164 @@
+#include "Game/InputRecorder.h"
+#include "Logger/Logger.h"
+#include <cstring>
+
+namespace {
+
+const char INPUT_MAGIC[8] = { 'P', '2', 'D', 'I', 'N', 'P', '1', '\0' };
+
+InputRecord ToRecord(uint64_t tick, const SDL_Event& event) {
+	InputRecord record = {};
+	record.tick = tick;
+	record.type = event.type;
+	switch (event.type) {
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+		record.values[0] = event.key.keysym.sym;
+		record.values[1] = event.key.keysym.scancode;
+		record.values[2] = event.key.keysym.mod;
+		record.values[3] = event.key.repeat;
+		break;
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+		record.values[0] = event.button.button;
+		record.values[1] = event.button.x;
+		record.values[2] = event.button.y;
+		record.values[3] = event.button.clicks;
+		break;
+	case SDL_MOUSEMOTION:
+		record.values[0] = static_cast<int32_t>(event.motion.state);
+		record.values[1] = event.motion.x;
+		record.values[2] = event.motion.y;
+		record.values[3] = event.motion.xrel;
+		record.values[4] = event.motion.yrel;
+		break;
+	case SDL_MOUSEWHEEL:
+		record.values[0] = event.wheel.x;
+		record.values[1] = event.wheel.y;
+		record.values[2] = static_cast<int32_t>(event.wheel.direction);
+		break;
+	}
+	return record;
+}
+
+SDL_Event ToEvent(const InputRecord& record) {
+	SDL_Event event;
+	std::memset(&event, 0, sizeof(event));
+	event.type = record.type;
+	switch (record.type) {
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+		event.key.state = record.type == SDL_KEYDOWN ? SDL_PRESSED : SDL_RELEASED;
+		event.key.keysym.sym = static_cast<SDL_Keycode>(record.values[0]);
+		event.key.keysym.scancode = static_cast<SDL_Scancode>(record.values[1]);
+		event.key.keysym.mod = static_cast<Uint16>(record.values[2]);
+		event.key.repeat = static_cast<Uint8>(record.values[3]);
+		break;
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+		event.button.state = record.type == SDL_MOUSEBUTTONDOWN ? SDL_PRESSED : SDL_RELEASED;
+		event.button.button = static_cast<Uint8>(record.values[0]);
+		event.button.x = record.values[1];
+		event.button.y = record.values[2];
+		event.button.clicks = static_cast<Uint8>(record.values[3]);
+		break;
+	case SDL_MOUSEMOTION:
+		event.motion.state = static_cast<Uint32>(record.values[0]);
+		event.motion.x = record.values[1];
+		event.motion.y = record.values[2];
+		event.motion.xrel = record.values[3];
+		event.motion.yrel = record.values[4];
+		break;
+	case SDL_MOUSEWHEEL:
+		event.wheel.x = record.values[0];
+		event.wheel.y = record.values[1];
+		event.wheel.direction = static_cast<Uint32>(record.values[2]);
+		break;
+	}
+	return event;
+}
+
+}
+
+InputRecorder::~InputRecorder() {
+	Close();
+}
+
+bool InputRecorder::Open(const std::string& path, int tickRate) {
+	Close();
+	file = std::fopen(path.c_str(), "wb");
+	if (!file) {
+		LOG_ERROR(CORE, "Failed to open the input recording " + path);
+		return false;
+	}
+	const int32_t rate = tickRate;
+	std::fwrite(INPUT_MAGIC, 1, sizeof(INPUT_MAGIC), file);
+	std::fwrite(&rate, sizeof(rate), 1, file);
+	LOG_INFO(CORE, "Recording input to " + path);
+	return true;
+}
+
+void InputRecorder::Close() {
+	if (file) {
+		std::fclose(file);
+		file = nullptr;
+	}
+}
+
+void InputRecorder::Record(uint64_t tick, const SDL_Event& event) {
+	if (!file) {
+		return;
+	}
+	const auto record = ToRecord(tick, event);
+	std::fwrite(&record, sizeof(record), 1, file);
+}
+
+bool InputRecorder::IsRecordable(const SDL_Event& event) {
+	switch (event.type) {
+	case SDL_QUIT:
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+	case SDL_MOUSEMOTION:
+	case SDL_MOUSEWHEEL:
+		return true;
+	}
+	return false;
+}
+
+bool InputPlayer::Open(const std::string& path) {
+	std::FILE* file = std::fopen(path.c_str(), "rb");
+	if (!file) {
+		LOG_ERROR(CORE, "Failed to open the input recording " + path);
+		return false;
+	}
+
+	char magic[sizeof(INPUT_MAGIC)];
+	int32_t rate = 0;
+	if (std::fread(magic, 1, sizeof(magic), file) != sizeof(magic) || std::memcmp(magic, INPUT_MAGIC, sizeof(magic)) != 0 ||
+		std::fread(&rate, sizeof(rate), 1, file) != 1 || rate <= 0) {
+		LOG_ERROR(CORE, path + " is not an input recording");
+		std::fclose(file);
+		return false;
+	}
+
+	records.clear();
+	next = 0;
+	tickRate = rate;
+	InputRecord record;
+	while (std::fread(&record, sizeof(record), 1, file) == 1) {
+		records.push_back(record);
+	}
+	std::fclose(file);
+	LOG_INFO(CORE, "Replaying " + std::to_string(records.size()) + " input events from " + path);
+	return true;
+}
+
+bool InputPlayer::Next(uint64_t tick, SDL_Event& event) {
+	if (next == records.size() || records[next].tick > tick) {
+		return false;
+	}
+	event = ToEvent(records[next++]);
+	return true;
+}
@@ -1,36 +1,326 @@
-
 #include "include/Logger/Logger.h"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <ctime>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <thread>
+
+std::atomic<int> Logger::runtimeLevel{LOG_LEVEL_INFO};
+std::atomic<uint32_t> Logger::categoryMask{~0u};
+
+namespace {
+
+// records in flight, a power of two
+const size_t RING_SIZE = 4096;
+// longer messages are truncated
+const size_t MAX_MESSAGE_LENGTH = 232;
+
+struct LogRecord {
+	// ring position this slot is ready for, see LogRing
+	std::atomic<size_t> sequence;
+	LogType type;
+	LogCategory category;
+	std::chrono::system_clock::rep time;
+	uint32_t length;
+	char text[MAX_MESSAGE_LENGTH];
+};
+
+/**
+ * Bounded multi-producer single-consumer ring (Vyukov's bounded queue). Each
+ * slot carries a sequence number: producers claim a position with one CAS and
+ * publish the slot by bumping its sequence, the consumer hands it back the
+ * same way. Nothing allocates after construction.
+ */
+class LogRing {
+private:
+	LogRecord records[RING_SIZE];
+	alignas(64) std::atomic<size_t> enqueuePosition{0};
+	alignas(64) size_t dequeuePosition = 0;
+
+public:
+	LogRing() {
+		for (size_t i = 0; i < RING_SIZE; i++) {
+			records[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
 
-std::vector<LogEntry> Logger::messages;
+	// False if the ring is full
+	bool Push(LogType type, LogCategory category, const std::string& message) {
+		size_t position = enqueuePosition.load(std::memory_order_relaxed);
+		LogRecord* record;
+		for (;;) {
+			record = &records[position & (RING_SIZE - 1)];
+			const auto sequence = record->sequence.load(std::memory_order_acquire);
+			const auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+			if (difference == 0) {
+				if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			} else if (difference < 0) {
+				return false;
+			} else {
+				position = enqueuePosition.load(std::memory_order_relaxed);
+			}
+		}
 
-std::string CurrentDateTimeToString() {
-    std::time_t now =
-    std::chrono::system_clock::to_time_t(std::chrono::system_clock ::now());
-    std::string output(30, '\0');
+		record->type = type;
+		record->category = category;
+		record->time = std::chrono::system_clock::now().time_since_epoch().count();
+		record->length = static_cast<uint32_t>(std::min(message.size(), MAX_MESSAGE_LENGTH));
+		std::memcpy(record->text, message.data(), record->length);
+		record->sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
 
-    //localtime is unsafe in x64 builds 
-    std::strftime(&output[0], output.size(), "%d-%b-%Y %H:%M:%S", std::localtime(&now));
+	// Consumer side: the next published record or nullptr, Release it once used
+	const LogRecord* Peek() const {
+		const auto& record = records[dequeuePosition & (RING_SIZE - 1)];
+		if (record.sequence.load(std::memory_order_acquire) != dequeuePosition + 1) {
+			return nullptr;
+		}
+		return &record;
+	}
 
-    return output;
+	void Release() {
+		records[dequeuePosition & (RING_SIZE - 1)].sequence.store(dequeuePosition + RING_SIZE, std::memory_order_release);
+		dequeuePosition++;
+	}
+
+	size_t GetEnqueuePosition() const { return enqueuePosition.load(std::memory_order_acquire); }
+};
+
+// Tag written in front of the message, Core messages have none
+const char* CategoryTag(LogCategory category) {
+	switch (category) {
+	case LOG_CATEGORY_CORE:
+		return "";
+	case LOG_CATEGORY_ECS:
+		return "[ECS] ";
+	case LOG_CATEGORY_RENDER:
+		return "[Render] ";
+	case LOG_CATEGORY_ASSET:
+		return "[Asset] ";
+	case LOG_CATEGORY_SCRIPT:
+		return "[Script] ";
+	}
+	return "";
 }
-void Logger::Log(const std::string &message) {
-    LogEntry logEntry;
-    logEntry.type = LOG_INFO;
-    logEntry.message = "LOG: [" + CurrentDateTimeToString() + "]" + message;
 
-    std::cout << "\x1B[32m" << logEntry.message << "\033[0m" << std::endl;
-    messages.push_back(logEntry);
+void DateTimeToString(std::chrono::system_clock::rep time, char* output, size_t size) {
+	const std::time_t seconds = std::chrono::system_clock::to_time_t(
+		std::chrono::system_clock::time_point(std::chrono::system_clock::duration(time)));
+
+	// only the logger thread formats, so localtime's static buffer is safe
+	std::strftime(output, size, "%d-%b-%Y %H:%M:%S", std::localtime(&seconds));
+}
+
+/**
+ * Fixed ring of the last LOG_HISTORY_SIZE lines. Allocates nothing once
+ * constructed; the oldest line is overwritten (or spilled to a file first).
+ * Written by the logger thread, read by whoever draws the console.
+ */
+class LogHistory {
+private:
+	std::mutex mutex;
+	LogEntry entries[LOG_HISTORY_SIZE];
+	// slot the next line goes to
+	size_t next = 0;
+	size_t count = 0;
+	std::FILE* spill = nullptr;
+
+public:
+	~LogHistory() {
+		if (spill) {
+			const auto oldest = (next + LOG_HISTORY_SIZE - count) % LOG_HISTORY_SIZE;
+			for (size_t i = 0; i < count; i++) {
+				std::fprintf(spill, "%s\n", entries[(oldest + i) % LOG_HISTORY_SIZE].message);
+			}
+			std::fclose(spill);
+		}
+	}
+
+	void Add(const LogEntry& entry) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (count == LOG_HISTORY_SIZE) {
+			if (spill) {
+				std::fprintf(spill, "%s\n", entries[next].message);
+			}
+		} else {
+			count++;
+		}
+		entries[next] = entry;
+		next = (next + 1) % LOG_HISTORY_SIZE;
+	}
+
+	size_t Copy(LogEntry* output, size_t maxCount) {
+		std::lock_guard<std::mutex> lock(mutex);
+		const auto copied = std::min(maxCount, count);
+		const auto first = (next + LOG_HISTORY_SIZE - copied) % LOG_HISTORY_SIZE;
+		for (size_t i = 0; i < copied; i++) {
+			output[i] = entries[(first + i) % LOG_HISTORY_SIZE];
+		}
+		return copied;
+	}
+
+	bool SpillTo(const std::string& path) {
+		std::FILE* file = std::fopen(path.c_str(), "a");
+		if (!file) {
+			return false;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		if (spill) {
+			std::fclose(spill);
+		}
+		spill = file;
+		return true;
+	}
+};
+
+/**
+ * Owns the ring and the thread that drains it. Created on first use and
+ * joined at exit, after writing whatever is still queued.
+ */
+class LogWriter {
+private:
+	LogRing ring;
+	LogHistory history;
+	std::atomic<uint64_t> dropped{0};
+	uint64_t droppedReported = 0;
+	// records written so far, Flush waits on it
+	std::atomic<size_t> written{0};
+	std::atomic<bool> running{true};
+	std::thread thread;
+
+	void Write(const LogRecord& record) {
+		LogEntry logEntry;
+		logEntry.type = record.type;
+		logEntry.category = record.category;
+
+		const char* prefix = "LOG";
+		const char* color = "\x1B[32m";
+		if (record.type == LOG_TYPE_ERROR) {
+			prefix = "ERR";
+			color = "\x1B[91m";
+		} else if (record.type == LOG_TYPE_WARNING) {
+			prefix = "WRN";
+			color = "\x1B[93m";
+		}
+
+		char dateTime[32];
+		DateTimeToString(record.time, dateTime, sizeof(dateTime));
+		std::snprintf(logEntry.message, sizeof(logEntry.message), "%s: [%s]%s%.*s", prefix, dateTime,
+					  CategoryTag(record.category), static_cast<int>(record.length), record.text);
+
+		auto& stream = record.type == LOG_TYPE_INFO ? std::cout : std::cerr;
+		stream << color << logEntry.message << "\033[0m" << '\n';
+		history.Add(logEntry);
+	}
+
+	void Run() {
+		for (;;) {
+			bool idle = true;
+			while (const LogRecord* record = ring.Peek()) {
+				Write(*record);
+				ring.Release();
+				written.fetch_add(1, std::memory_order_release);
+				idle = false;
+			}
+
+			const auto droppedNow = dropped.load(std::memory_order_relaxed);
+			if (droppedNow != droppedReported) {
+				std::cerr << "\x1B[91m" << "ERR: " << droppedNow - droppedReported << " log records dropped, the ring was full" << "\033[0m" << '\n';
+				droppedReported = droppedNow;
+			}
+
+			if (idle) {
+				// the console is flushed once per burst rather than per line
+				std::cout.flush();
+				std::cerr.flush();
+				if (!running.load(std::memory_order_acquire)) {
+					return;
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+	}
+
+public:
+	LogWriter() : thread(&LogWriter::Run, this) {}
+
+	~LogWriter() {
+		running.store(false, std::memory_order_release);
+		thread.join();
+	}
+
+	void Push(LogType type, LogCategory category, const std::string& message) {
+		if (!ring.Push(type, category, message)) {
+			dropped.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	void Flush() {
+		// dropped records never claimed a position
+		const auto target = ring.GetEnqueuePosition();
+		while (written.load(std::memory_order_acquire) < target) {
+			std::this_thread::yield();
+		}
+	}
+
+	uint64_t GetDroppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+	LogHistory& GetHistory() { return history; }
+};
+
+LogWriter& GetWriter() {
+	static LogWriter writer;
+	return writer;
+}
+
+}
+
+void Logger::Log(const std::string &message) {
+	GetWriter().Push(LOG_TYPE_INFO, LOG_CATEGORY_CORE, message);
 }
 
 void Logger::Err(const std::string &message) {
-	LogEntry logEntry;
-	logEntry.type = LOG_ERROR;
-	logEntry.message = "ERR: [" + CurrentDateTimeToString() + "]" + message;
+	GetWriter().Push(LOG_TYPE_ERROR, LOG_CATEGORY_CORE, message);
+	Flush();
+}
+
+void Logger::Write(LogLevel level, LogCategory category, const std::string &message) {
+	if (level >= LOG_LEVEL_ERROR) {
+		GetWriter().Push(LOG_TYPE_ERROR, category, message);
+		Flush();
+	} else {
+		GetWriter().Push(level == LOG_LEVEL_WARN ? LOG_TYPE_WARNING : LOG_TYPE_INFO, category, message);
+	}
+}
+
+void Logger::SetCategoryEnabled(LogCategory category, bool enabled) {
+	if (enabled) {
+		categoryMask.fetch_or(1u << category, std::memory_order_relaxed);
+	} else {
+		categoryMask.fetch_and(~(1u << category), std::memory_order_relaxed);
+	}
+}
+
+void Logger::Flush() {
+	GetWriter().Flush();
+}
+
+uint64_t Logger::GetDroppedCount() {
+	return GetWriter().GetDroppedCount();
+}
 
-	std::cerr << "\x1B[91m" << logEntry.message << "\033[0m" << std::endl;
-	messages.push_back(logEntry);
-}
\ No newline at end of file
+size_t Logger::CopyHistory(LogEntry *entries, size_t count) {
+	return GetWriter().GetHistory().Copy(entries, count);
+}
+
+bool Logger::SpillHistoryTo(const std::string &path) {
+	return GetWriter().GetHistory().SpillTo(path);
+}
@@ -1,8 +1,39 @@
 #include "Game/Game.h"
+#include <cstdlib>
+#include <cstring>
 
 int main(int argc, char *argv[]) {
   
     Game game;
+	for (int i = 1; i < argc; i++) {
+		// --pipelined simulates on a second thread while this one renders.
+		// --headless opens no window and simulates as fast as possible for
+		// --frames N or --seconds S, then prints the throughput.
+		// --record and --replay save input to a file and play it back at the
+		// same steps, headless too.
+		// --profile writes a Chrome trace of the run on exit.
+		// --no-vsync stops presenting from waiting for the display; the frame
+		// rate is then capped by --fps N (60 by default), 0 for uncapped.
+		if (std::strcmp(argv[i], "--pipelined") == 0) {
+			game.SetPipelined(true);
+		} else if (std::strcmp(argv[i], "--headless") == 0) {
+			game.SetHeadless(true);
+		} else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			game.SetFrameLimit(std::strtoull(argv[++i], nullptr, 10));
+		} else if (std::strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+			game.SetSecondsLimit(std::strtod(argv[++i], nullptr));
+		} else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			game.SetInputRecording(argv[++i]);
+		} else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+			game.SetInputReplay(argv[++i]);
+		} else if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+			game.SetProfileExport(argv[++i]);
+		} else if (std::strcmp(argv[i], "--no-vsync") == 0) {
+			game.SetVsync(false);
+		} else if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+			game.SetTargetFrameRate(std::atoi(argv[++i]));
+		}
+	}
 	game.Initialize();
 	game.Run();
 	game.Destroy();
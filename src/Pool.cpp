@@ -0,0 +1,29 @@
+#include "ECS/Pool.h"
+
+void SparseSet::Swap(int indexA, int indexB) {
+	if (indexA == indexB) {
+		return;
+	}
+	const auto entityA = indexToEntityId[indexA];
+	const auto entityB = indexToEntityId[indexB];
+
+	SwapData(indexA, indexB);
+	std::swap(indexToEntityId[indexA], indexToEntityId[indexB]);
+	entityIdToIndex[entityA] = indexB;
+	entityIdToIndex[entityB] = indexA;
+}
+
+bool SparseSet::CompactIndex(size_t capacity, size_t& slotBudget, size_t& reclaimed) {
+	// the sparse array only needs to reach the highest live entity id: drop the
+	// empty entries above it, a slot of budget each
+	while (!entityIdToIndex.empty() && entityIdToIndex.back() == -1) {
+		if (slotBudget == 0) {
+			return false;
+		}
+		entityIdToIndex.pop_back();
+		slotBudget--;
+	}
+	const auto sparseCapacity = std::max(entityIdToIndex.size(), minimumCapacity);
+	return ShrinkStep(entityIdToIndex, sparseCapacity, slotBudget, reclaimed) && 
+		ShrinkStep(indexToEntityId, capacity, slotBudget, reclaimed);
+}
@@ -0,0 +1,244 @@
+#include "Profiler/Profiler.h"
+#include "Logger/Logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__GNUC__)
+#include <cxxabi.h>
+#include <cstdlib>
+#endif
+
+namespace {
+
+struct ZoneRecord {
+	const char* name;
+	Profiler::Clock::time_point start;
+	Profiler::Clock::time_point end;
+};
+
+// A ring slot. The fields are atomics so the exporter may read a slot while
+// its thread overwrites it; release stores and acquire loads compile to
+// plain moves on x86.
+struct ZoneSlot {
+	std::atomic<const char*> name{ nullptr };
+	std::atomic<Profiler::Clock::rep> start{ 0 };
+	std::atomic<Profiler::Clock::rep> end{ 0 };
+};
+
+/**
+ * The zones of one thread: a single producer ring that its thread writes
+ * without locking, overwriting the oldest zone when full. The exporter copies
+ * it as a seqlock reader would, dropping the slots overwritten meanwhile.
+ * Only acquire/release operations order the two sides: a slot value the
+ * exporter reads carries the started count of the zone that wrote it.
+ */
+struct ThreadZones {
+	std::unique_ptr<ZoneSlot[]> zones;
+	// zones started and finished so far; zone i lives in slot i % size
+	std::atomic<uint64_t> started{ 0 };
+	std::atomic<uint64_t> written{ 0 };
+	uint32_t threadId;
+
+	// rarely set, the lock is not on the recording path
+	std::mutex nameMutex;
+	std::string threadName;
+
+	explicit ThreadZones(uint32_t threadId) : zones(new ZoneSlot[PROFILER_ZONES_PER_THREAD]), threadId(threadId) {}
+
+	// Only called by the owning thread
+	void Record(const char* name, Profiler::Clock::time_point start, Profiler::Clock::time_point end) {
+		const auto index = written.load(std::memory_order_relaxed);
+		started.store(index + 1, std::memory_order_relaxed);
+		auto& slot = zones[index % PROFILER_ZONES_PER_THREAD];
+		slot.name.store(name, std::memory_order_release);
+		slot.start.store(start.time_since_epoch().count(), std::memory_order_release);
+		slot.end.store(end.time_since_epoch().count(), std::memory_order_release);
+		written.store(index + 1, std::memory_order_release);
+	}
+
+	// Appends the zones still in the ring, oldest first. Safe from any thread
+	// while the owner keeps recording.
+	void CopyZones(std::vector<ZoneRecord>& output) {
+		const auto end = written.load(std::memory_order_acquire);
+		const auto begin = end - std::min<uint64_t>(end, PROFILER_ZONES_PER_THREAD);
+		std::vector<ZoneRecord> copied;
+		copied.reserve(end - begin);
+		for (auto i = begin; i < end; i++) {
+			const auto& slot = zones[i % PROFILER_ZONES_PER_THREAD];
+			copied.push_back(ZoneRecord{ slot.name.load(std::memory_order_acquire),
+				Profiler::Clock::time_point(Profiler::Clock::duration(slot.start.load(std::memory_order_acquire))),
+				Profiler::Clock::time_point(Profiler::Clock::duration(slot.end.load(std::memory_order_acquire))) });
+		}
+		// zone i was overwritten if zone i + size was started meanwhile; any
+		// slot read from such a zone makes its started count visible here
+		const auto overwritten = started.load(std::memory_order_relaxed);
+		const auto firstIntact = overwritten > PROFILER_ZONES_PER_THREAD ? overwritten - PROFILER_ZONES_PER_THREAD : 0;
+		const auto skipped = std::min<uint64_t>(std::max(begin, firstIntact) - begin, copied.size());
+		output.insert(output.end(), copied.begin() + skipped, copied.end());
+	}
+};
+
+/**
+ * Every thread's ring, kept until exit so finished threads still export
+ */
+class ProfilerState {
+private:
+	std::mutex mutex;
+	std::vector<std::shared_ptr<ThreadZones>> threads;
+	std::unordered_map<const std::type_info*, std::string> names;
+
+public:
+	std::shared_ptr<ThreadZones> AddThread() {
+		std::lock_guard<std::mutex> lock(mutex);
+		threads.push_back(std::make_shared<ThreadZones>(static_cast<uint32_t>(threads.size() + 1)));
+		return threads.back();
+	}
+
+	std::vector<std::shared_ptr<ThreadZones>> GetThreads() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return threads;
+	}
+
+	const char* InternName(const std::type_info& type) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto name = names.find(&type);
+		if (name != names.end()) {
+			return name->second.c_str();
+		}
+		std::string readable = type.name();
+#if defined(__GNUC__)
+		int status = 0;
+		char* demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+		if (status == 0 && demangled) {
+			readable = demangled;
+		}
+		std::free(demangled);
+#endif
+		// MSVC names are readable already, minus the keyword
+		for (const char* prefix: { "class ", "struct " }) {
+			if (readable.compare(0, std::strlen(prefix), prefix) == 0) {
+				readable.erase(0, std::strlen(prefix));
+			}
+		}
+		return names.emplace(&type, readable).first->second.c_str();
+	}
+};
+
+ProfilerState& GetState() {
+	static ProfilerState state;
+	return state;
+}
+
+ThreadZones& GetThreadZones() {
+	thread_local std::shared_ptr<ThreadZones> zones = GetState().AddThread();
+	return *zones;
+}
+
+#if PROFILER_ENABLED
+// Names are literals or type names, escape what JSON requires anyway
+void WriteJsonString(std::FILE* file, const char* text) {
+	std::fputc('"', file);
+	for (; *text; text++) {
+		if (*text == '"' || *text == '\\') {
+			std::fputc('\\', file);
+		}
+		if (static_cast<unsigned char>(*text) >= 0x20) {
+			std::fputc(*text, file);
+		}
+	}
+	std::fputc('"', file);
+}
+#endif
+
+}
+
+void Profiler::Record(const char* name, Clock::time_point start, Clock::time_point end) {
+	GetThreadZones().Record(name, start, end);
+}
+
+void Profiler::SetThreadName(const std::string& name) {
+#if PROFILER_ENABLED
+	auto& thread = GetThreadZones();
+	std::lock_guard<std::mutex> lock(thread.nameMutex);
+	thread.threadName = name;
+#else
+	(void)name;
+#endif
+}
+
+const char* Profiler::InternName(const std::type_info& type) {
+	return GetState().InternName(type);
+}
+
+bool Profiler::ExportChromeTrace([[maybe_unused]] const std::string& path, double lastSeconds) {
+#if !PROFILER_ENABLED
+	(void)lastSeconds;
+	LOG_WARN(CORE, "No trace written to " + path + ", profiling is compiled out (meson option profiler)");
+	return false;
+#else
+	std::FILE* file = std::fopen(path.c_str(), "w");
+	if (!file) {
+		LOG_ERROR(CORE, "Failed to open " + path + " for the trace");
+		return false;
+	}
+
+	// timestamps relative to the oldest zone exported, in microseconds
+	const auto now = Clock::now();
+	const auto cutoff = lastSeconds > 0.0 ?
+		now - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(lastSeconds)) : Clock::time_point::min();
+
+	struct ExportedZone {
+		ZoneRecord zone;
+		uint32_t threadId;
+	};
+	std::vector<ExportedZone> exported;
+	std::vector<std::pair<uint32_t, std::string>> threadNames;
+	std::vector<ZoneRecord> zones;
+	for (auto& thread: GetState().GetThreads()) {
+		zones.clear();
+		thread->CopyZones(zones);
+		for (const auto& zone: zones) {
+			if (zone.end >= cutoff) {
+				exported.push_back(ExportedZone{ zone, thread->threadId });
+			}
+		}
+		std::lock_guard<std::mutex> lock(thread->nameMutex);
+		threadNames.emplace_back(thread->threadId, thread->threadName.empty() ?
+			"Thread " + std::to_string(thread->threadId) : thread->threadName);
+	}
+
+	auto origin = now;
+	for (const auto& zone: exported) {
+		origin = std::min(origin, zone.zone.start);
+	}
+
+	std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first = true;
+	for (const auto& thread: threadNames) {
+		std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", thread.first);
+		WriteJsonString(file, thread.second.c_str());
+		std::fprintf(file, "}}");
+		first = false;
+	}
+	for (const auto& zone: exported) {
+		const double start = std::chrono::duration<double, std::micro>(zone.zone.start - origin).count();
+		const double duration = std::chrono::duration<double, std::micro>(zone.zone.end - zone.zone.start).count();
+		std::fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+		WriteJsonString(file, zone.zone.name);
+		std::fprintf(file, ",\"cat\":\"zone\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", zone.threadId, start, duration);
+		first = false;
+	}
+	std::fprintf(file, "\n]}\n");
+
+	const bool written = std::fclose(file) == 0;
+	LOG_INFO(CORE, "Wrote " + std::to_string(exported.size()) + " profiler zones to " + path);
+	return written;
+#endif
+}
@@ -0,0 +1,159 @@
+#include "ECS/RuntimePool.h"
+
+#include <cstring>
+
+ComponentLayout& ComponentLayout::AddField(const std::string& fieldName, FieldType type) {
+	if (FindField(fieldName) != -1) {
+		LOG_ERROR(ECS, "Component " + name + " already has a field " + fieldName);
+		return *this;
+	}
+	fields.push_back({ fieldName, type, SizeOf(type) });
+	return *this;
+}
+
+int ComponentLayout::FindField(const std::string& fieldName) const {
+	for (size_t i = 0; i < fields.size(); i++) {
+		if (fields[i].name == fieldName) {
+			return static_cast<int>(i);
+		}
+	}
+	return -1;
+}
+
+bool ComponentLayout::SameFields(const ComponentLayout& other) const {
+	if (fields.size() != other.fields.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < fields.size(); i++) {
+		if (fields[i].name != other.fields[i].name || fields[i].type != other.fields[i].type) {
+			return false;
+		}
+	}
+	return true;
+}
+
+size_t ComponentLayout::SizeOf(FieldType type) {
+	switch (type) {
+	case FieldType::Number:
+		return sizeof(double);
+	case FieldType::Integer:
+		return sizeof(int64_t);
+	case FieldType::Boolean:
+		return sizeof(bool);
+	}
+	return 0;
+}
+
+bool ComponentLayout::ParseType(const std::string& typeName, FieldType& type) {
+	if (typeName == "number") {
+		type = FieldType::Number;
+	} else if (typeName == "integer") {
+		type = FieldType::Integer;
+	} else if (typeName == "boolean") {
+		type = FieldType::Boolean;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+ByteColumnPool::ByteColumnPool(ComponentLayout layout)
+	: layout(std::move(layout)), columns(this->layout.GetFields().size()) {
+}
+
+void ByteColumnPool::SwapData(int indexA, int indexB) {
+	for (size_t field = 0; field < columns.size(); field++) {
+		const auto size = layout.GetFields()[field].size;
+		std::swap_ranges(columns[field].begin() + indexA * size, columns[field].begin() + (indexA + 1) * size,
+						 columns[field].begin() + indexB * size);
+	}
+}
+
+void ByteColumnPool::Add(int entityId) {
+	if (Contains(entityId)) {
+		return;
+	}
+	if (entityId >= static_cast<int>(entityIdToIndex.size())) {
+		entityIdToIndex.resize(entityId + 1, -1);
+	}
+	entityIdToIndex[entityId] = static_cast<int>(indexToEntityId.size());
+	indexToEntityId.push_back(entityId);
+	for (size_t field = 0; field < columns.size(); field++) {
+		columns[field].resize(columns[field].size() + layout.GetFields()[field].size, 0);
+	}
+	peakSize = std::max(peakSize, indexToEntityId.size());
+}
+
+void ByteColumnPool::Remove(int entityId) {
+	if (!Contains(entityId)) {
+		return;
+	}
+	Swap(entityIdToIndex[entityId], static_cast<int>(indexToEntityId.size()) - 1);
+	entityIdToIndex[entityId] = -1;
+	indexToEntityId.pop_back();
+	for (size_t field = 0; field < columns.size(); field++) {
+		columns[field].resize(columns[field].size() - layout.GetFields()[field].size);
+	}
+}
+
+void ByteColumnPool::RemoveEntities(const std::vector<int>& entityIds) {
+	for (auto entityId: entityIds) {
+		Remove(entityId);
+	}
+}
+
+void ByteColumnPool::Clear() {
+	for (auto& column: columns) {
+		column.clear();
+	}
+	entityIdToIndex.clear();
+	indexToEntityId.clear();
+}
+
+void ByteColumnPool::Reserve(int count) {
+	minimumCapacity = std::max(minimumCapacity, static_cast<size_t>(count));
+	for (size_t field = 0; field < columns.size(); field++) {
+		columns[field].reserve(count * layout.GetFields()[field].size);
+	}
+	entityIdToIndex.reserve(count);
+	indexToEntityId.reserve(count);
+}
+
+void ByteColumnPool::MoveEntitiesTo(IPool& destination, const std::vector<int>& sourceIds, const std::vector<int>& destinationIds) {
+	auto& destinationPool = static_cast<ByteColumnPool&>(destination);
+	for (size_t i = 0; i < sourceIds.size(); i++) {
+		if (!Contains(sourceIds[i])) {
+			continue;
+		}
+		destinationPool.Add(destinationIds[i]);
+		for (size_t field = 0; field < columns.size(); field++) {
+			std::memcpy(destinationPool.Field(destinationIds[i], static_cast<int>(field)),
+						Field(sourceIds[i], static_cast<int>(field)), layout.GetFields()[field].size);
+		}
+		Remove(sourceIds[i]);
+	}
+}
+
+size_t ByteColumnPool::Compact(size_t& slotBudget) {
+	const auto capacity = std::max({ peakSize, GetSize(), minimumCapacity });
+	size_t reclaimed = 0;
+	if (!CompactIndex(capacity, slotBudget, reclaimed)) {
+		return reclaimed;
+	}
+	for (size_t field = 0; field < columns.size(); field++) {
+		const auto fieldSize = layout.GetFields()[field].size;
+		if (!ShrinkStep(columns[field], capacity * fieldSize, slotBudget, reclaimed, fieldSize)) {
+			return reclaimed;
+		}
+	}
+	peakSize = GetSize();
+	return reclaimed;
+}
+
+size_t ByteColumnPool::MemoryUsage() const {
+	size_t bytes = (entityIdToIndex.capacity() + indexToEntityId.capacity()) * sizeof(int);
+	for (auto& column: columns) {
+		bytes += column.capacity();
+	}
+	return bytes;
+}
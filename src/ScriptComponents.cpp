@@ -0,0 +1,238 @@
+#include "Scripting/ScriptComponents.h"
+#include "Logger/Logger.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// What a script holds for one component of one entity. It refers to the
+// pool rather than the bytes, so it stays valid when the pool grows or
+// reorders, and goes stale when the component is removed. The handle's
+// generation tells a killed entity from the one that reuses its id.
+struct ScriptComponentRef {
+	Registry* registry;
+	ByteColumnPool* pool;
+	EntityHandle entity;
+};
+
+// The field's address, nullptr (after logging) if the component is gone or
+// has no such field. A reference outliving its entity raises a Lua error.
+unsigned char* FindField(const ScriptComponentRef& component, const std::string& name, FieldType& type) {
+	const auto entityId = component.entity.GetId();
+	if (!component.registry->IsAlive(component.entity)) {
+		throw sol::error("entity id " + std::to_string(entityId) + " of this " + component.pool->GetLayout().GetName() + " was killed");
+	}
+	if (!component.pool->Contains(entityId)) {
+		LOG_ERROR(SCRIPT, "Entity id " + std::to_string(entityId) + " no longer has a " + component.pool->GetLayout().GetName());
+		return nullptr;
+	}
+	const auto field = component.pool->GetLayout().FindField(name);
+	if (field == -1) {
+		LOG_ERROR(SCRIPT, component.pool->GetLayout().GetName() + " has no field " + name);
+		return nullptr;
+	}
+	type = component.pool->GetLayout().GetFields()[field].type;
+	return component.pool->Field(entityId, field);
+}
+
+sol::object ReadField(const ScriptComponentRef& component, const std::string& name, sol::this_state state) {
+	FieldType type;
+	const auto address = FindField(component, name, type);
+	if (!address) {
+		return sol::make_object(state, sol::lua_nil);
+	}
+	switch (type) {
+	case FieldType::Number: {
+		double value;
+		std::memcpy(&value, address, sizeof(value));
+		return sol::make_object(state, value);
+	}
+	case FieldType::Integer: {
+		int64_t value;
+		std::memcpy(&value, address, sizeof(value));
+		return sol::make_object(state, value);
+	}
+	case FieldType::Boolean: {
+		bool value;
+		std::memcpy(&value, address, sizeof(value));
+		return sol::make_object(state, value);
+	}
+	}
+	return sol::make_object(state, sol::lua_nil);
+}
+
+void WriteField(const ScriptComponentRef& component, const std::string& name, const sol::object& value) {
+	FieldType type;
+	const auto address = FindField(component, name, type);
+	if (!address) {
+		return;
+	}
+	switch (type) {
+	case FieldType::Number: {
+		if (!value.is<double>()) {
+			break;
+		}
+		const auto number = value.as<double>();
+		std::memcpy(address, &number, sizeof(number));
+		return;
+	}
+	case FieldType::Integer: {
+		if (!value.is<int64_t>()) {
+			break;
+		}
+		const auto integer = value.as<int64_t>();
+		std::memcpy(address, &integer, sizeof(integer));
+		return;
+	}
+	case FieldType::Boolean: {
+		if (!value.is<bool>()) {
+			break;
+		}
+		const auto boolean = value.as<bool>();
+		std::memcpy(address, &boolean, sizeof(boolean));
+		return;
+	}
+	}
+	LOG_ERROR(SCRIPT, "Wrong type assigned to " + component.pool->GetLayout().GetName() + "." + name);
+}
+
+// Component ids and entities come from scripts: anything that is not a
+// registered runtime type or a live entity raises a Lua error (sol turns the
+// exception into one) rather than reaching the registry
+ByteColumnPool& CheckedPool(Registry& registry, int componentId) {
+	if (!registry.IsRuntimeComponent(componentId)) {
+		throw sol::error("component id " + std::to_string(componentId) + " was not made by define_component");
+	}
+	return registry.GetRuntimePool(componentId);
+}
+
+void CheckAlive(Registry& registry, const Entity& entity) {
+	if (!registry.IsAlive(entity.GetHandle())) {
+		throw sol::error("entity id " + std::to_string(entity.GetId()) + " was killed");
+	}
+}
+
+}
+
+void BindScriptComponents(sol::state& lua, Registry& registry) {
+	lua.new_usertype<ScriptComponentRef>("ScriptComponent",
+		sol::no_constructor,
+		sol::meta_function::index, &ReadField,
+		sol::meta_function::new_index, &WriteField
+	);
+
+	lua.new_usertype<Entity>("Entity",
+		sol::no_constructor,
+		"id", &Entity::GetId,
+		"kill", &Entity::Kill,
+		// Adds the component (fields zeroed) and returns it
+		"add", [&registry](Entity& entity, int componentId) {
+			auto& pool = CheckedPool(registry, componentId);
+			CheckAlive(registry, entity);
+			registry.AddComponent(entity, componentId);
+			return ScriptComponentRef{ &registry, &pool, entity.GetHandle() };
+		},
+		"get", [&registry](Entity& entity, int componentId, sol::this_state state) {
+			auto& pool = CheckedPool(registry, componentId);
+			CheckAlive(registry, entity);
+			if (!registry.HasComponent(entity, componentId)) {
+				return sol::make_object(state, sol::lua_nil);
+			}
+			return sol::make_object(state, ScriptComponentRef{ &registry, &pool, entity.GetHandle() });
+		},
+		"has", [&registry](Entity& entity, int componentId) {
+			CheckedPool(registry, componentId);
+			return registry.IsAlive(entity.GetHandle()) && registry.HasComponent(entity, componentId);
+		},
+		"remove", [&registry](Entity& entity, int componentId) {
+			CheckedPool(registry, componentId);
+			CheckAlive(registry, entity);
+			registry.RemoveComponent(entity, componentId);
+		}
+	);
+
+	// define_component(name, { field = "type", ... }) returns the component id
+	lua.set_function("define_component", [&registry](const std::string& name, sol::table fields) {
+		// table order is unspecified, sort so the layout is the same every run
+		std::vector<std::pair<std::string, std::string>> declared;
+		for (auto& field: fields) {
+			declared.emplace_back(field.first.as<std::string>(), field.second.as<std::string>());
+		}
+		std::sort(declared.begin(), declared.end());
+
+		ComponentLayout layout(name);
+		for (auto& field: declared) {
+			FieldType type;
+			if (!ComponentLayout::ParseType(field.second, type)) {
+				LOG_ERROR(SCRIPT, "Unknown type " + field.second + " for " + name + "." + field.first);
+				continue;
+			}
+			layout.AddField(field.first, type);
+		}
+		const auto componentId = registry.RegisterComponent(layout);
+		if (componentId == -1) {
+			throw sol::error("no component id left for " + name);
+		}
+		return componentId;
+	});
+
+	// query({ Health, Armor }, function(entity, health, armor) ... end) visits
+	// every entity with all the components, see Registry::EachWith
+	lua.set_function("query", [&registry](sol::table componentIds, sol::protected_function func) {
+		std::vector<int> ids;
+		std::vector<ByteColumnPool*> pools;
+		for (size_t i = 1; i <= componentIds.size(); i++) {
+			const int componentId = componentIds[i];
+			pools.push_back(&CheckedPool(registry, componentId));
+			ids.push_back(componentId);
+		}
+		if (ids.empty()) {
+			throw sol::error("query needs at least one component");
+		}
+
+		std::vector<ScriptComponentRef> components(pools.size());
+		bool failed = false;
+		registry.EachWith(ids, [&](Entity entity) {
+			if (failed) {
+				return;
+			}
+			for (size_t i = 0; i < pools.size(); i++) {
+				components[i] = ScriptComponentRef{ &registry, pools[i], entity.GetHandle() };
+			}
+			sol::protected_function_result result = func(entity, sol::as_args(components));
+			if (!result.valid()) {
+				sol::error error = result;
+				LOG_ERROR(SCRIPT, std::string("Script error: ") + error.what());
+				failed = true;
+			}
+		});
+	});
+
+	lua.set_function("create_entity", [&registry]() {
+		return registry.CreateEntity();
+	});
+
+	// each(componentId, function(entity, component) ... end) visits every
+	// entity with the component. Walks backwards so the function may remove
+	// the component it was given.
+	lua.set_function("each", [&registry](int componentId, sol::protected_function func) {
+		auto& pool = CheckedPool(registry, componentId);
+		for (auto i = pool.GetSize(); i-- > 0;) {
+			if (i >= pool.GetSize()) {
+				continue;
+			}
+			const auto entityId = pool.EntityAt(static_cast<int>(i));
+			const auto handle = registry.GetHandle(entityId);
+			sol::protected_function_result result = func(registry.GetEntity(handle), ScriptComponentRef{ &registry, &pool, handle });
+			if (!result.valid()) {
+				sol::error error = result;
+				LOG_ERROR(SCRIPT, std::string("Script error: ") + error.what());
+				return;
+			}
+		}
+	});
+}
@@ -0,0 +1,76 @@
+#include "ECS/VirtualArray.h"
+#include "Logger/Logger.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+size_t VirtualMemory::PageSize() {
+#ifdef _WIN32
+	static const size_t pageSize = [] {
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return static_cast<size_t>(info.dwPageSize);
+	}();
+#else
+	static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+	return pageSize;
+}
+
+void* VirtualMemory::Reserve(size_t bytes) {
+#ifdef _WIN32
+	void* address = VirtualAlloc(nullptr, bytes, MEM_RESERVE, PAGE_NOACCESS);
+#else
+	void* address = mmap(nullptr, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (address == MAP_FAILED) {
+		address = nullptr;
+	}
+#endif
+	if (!address) {
+		LOG_ERROR(ECS, "Failed to reserve " + std::to_string(bytes) + " bytes of address space");
+	}
+	return address;
+}
+
+bool VirtualMemory::Commit(void* address, size_t bytes, bool hugePages) {
+#ifdef _WIN32
+	// large pages need a privilege most users lack, hugePages is ignored
+	(void)hugePages;
+	const bool committed = VirtualAlloc(address, bytes, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+	const bool committed = mprotect(address, bytes, PROT_READ | PROT_WRITE) == 0;
+#ifdef MADV_HUGEPAGE
+	if (committed && hugePages) {
+		madvise(address, bytes, MADV_HUGEPAGE);
+	}
+#else
+	(void)hugePages;
+#endif
+#endif
+	if (!committed) {
+		LOG_ERROR(ECS, "Failed to commit " + std::to_string(bytes) + " bytes");
+	}
+	return committed;
+}
+
+void VirtualMemory::Decommit(void* address, size_t bytes) {
+#ifdef _WIN32
+	VirtualFree(address, bytes, MEM_DECOMMIT);
+#else
+	madvise(address, bytes, MADV_DONTNEED);
+	mprotect(address, bytes, PROT_NONE);
+#endif
+}
+
+void VirtualMemory::Release(void* address, size_t bytes) {
+#ifdef _WIN32
+	(void)bytes;
+	VirtualFree(address, 0, MEM_RELEASE);
+#else
+	munmap(address, bytes);
+#endif
+}
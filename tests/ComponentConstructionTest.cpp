@@ -0,0 +1,81 @@
+#include "ECS/ECS.h"
+
+#include <cstdio>
+
+// AddComponent constructs each component exactly once and never assigns,
+// for every storage policy, whether the entity is getting the component or
+// replacing it
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			failures++; \
+		} \
+	} while (0)
+
+int constructions = 0;
+int assignments = 0;
+
+// Counts every constructor call, copies and moves included, and every
+// assignment (a replacement built as a temporary and moved in would show
+// up there). One type per storage policy so each gets its own pool.
+template <StoragePolicy policy>
+struct CountingComponent {
+	int value;
+
+	CountingComponent(int value = 0): value(value) { constructions++; }
+	CountingComponent(const CountingComponent& other): value(other.value) { constructions++; }
+	CountingComponent(CountingComponent&& other): value(other.value) { constructions++; }
+	CountingComponent& operator=(const CountingComponent& other) { value = other.value; assignments++; return *this; }
+	CountingComponent& operator=(CountingComponent&& other) { value = other.value; assignments++; return *this; }
+};
+
+}
+
+template <StoragePolicy policy>
+struct ComponentTraits<CountingComponent<policy>>: DefaultComponentTraits {
+	static constexpr StoragePolicy storage = policy;
+};
+
+template <StoragePolicy policy>
+void CheckOneConstructionPerAdd(Registry& registry) {
+	using TComponent = CountingComponent<policy>;
+	auto entity = registry.CreateEntity();
+
+	constructions = 0;
+	assignments = 0;
+	registry.AddComponent<TComponent>(entity, 1);
+	CHECK(constructions == 1 && assignments == 0);
+	CHECK(registry.GetComponent<TComponent>(entity).value == 1);
+
+	constructions = 0;
+	assignments = 0;
+	registry.AddComponent<TComponent>(entity, 2);
+	CHECK(constructions == 1 && assignments == 0);
+	CHECK(registry.GetComponent<TComponent>(entity).value == 2);
+
+	registry.RemoveComponent<TComponent>(entity);
+	constructions = 0;
+	assignments = 0;
+	registry.AddComponents<TComponent>(entity, 3);
+	CHECK(constructions == 1 && assignments == 0);
+	CHECK(registry.GetComponent<TComponent>(entity).value == 3);
+}
+
+int main() {
+	Registry registry;
+	CheckOneConstructionPerAdd<StoragePolicy::Dense>(registry);
+	CheckOneConstructionPerAdd<StoragePolicy::Sparse>(registry);
+	CheckOneConstructionPerAdd<StoragePolicy::Paged>(registry);
+	CheckOneConstructionPerAdd<StoragePolicy::Singleton>(registry);
+
+	if (failures == 0) {
+		std::printf("component construction: ok\n");
+	}
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,60 @@
+#include "ECS/ECS.h"
+
+#include <cstdio>
+#include <cstring>
+
+// Runtime components stay runtime components when MoveEntities carries
+// their pool into a registry that has not registered them
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			failures++; \
+		} \
+	} while (0)
+
+double ReadNumber(Registry& registry, int componentId, int entityId) {
+	double value;
+	std::memcpy(&value, registry.GetRuntimePool(componentId).Field(entityId, 0), sizeof(value));
+	return value;
+}
+
+}
+
+int main() {
+	ComponentLayout layout("MoveTestHealth");
+	layout.AddField("hp", FieldType::Number);
+
+	Registry from;
+	Registry to;
+	const auto componentId = from.RegisterComponent(layout);
+	CHECK(componentId != -1);
+
+	auto entity = from.CreateEntity();
+	from.AddComponent(entity, componentId);
+	const double hp = 42.5;
+	std::memcpy(from.GetRuntimePool(componentId).Field(entity.GetId(), 0), &hp, sizeof(hp));
+	from.Update();
+
+	const auto moved = MoveEntities({ entity }, from, to);
+	CHECK(moved.size() == 1);
+	if (moved.size() == 1) {
+		CHECK(to.IsRuntimeComponent(componentId));
+		CHECK(to.HasComponent(moved[0], componentId));
+		CHECK(ReadNumber(to, componentId, moved[0].GetId()) == hp);
+
+		// registering in the destination finds the pool the move created
+		CHECK(to.RegisterComponent(layout) == componentId);
+		CHECK(to.HasComponent(moved[0], componentId));
+	}
+
+	if (failures == 0) {
+		std::printf("runtime component move: ok\n");
+	}
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+#include "ECS/VirtualArray.h"
+
+#include <cstdio>
+#include <new>
+
+// VirtualArray grows past its first commit without moving, and running out
+// of its reservation fails cleanly instead of writing past the mapping
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			failures++; \
+		} \
+	} while (0)
+
+// three 64 KiB commit chunks, a whole number of pages on every platform we
+// ship, so the reservation ends exactly at the last element
+const size_t RESERVED = 3 * 64 * 1024 / sizeof(int);
+
+}
+
+int main() {
+	VirtualArray<int> array(RESERVED);
+	CHECK(array.empty());
+
+	array.push_back(0);
+	const auto firstCapacity = array.capacity();
+	const auto* firstAddress = &array[0];
+	CHECK(firstCapacity > 0);
+	CHECK(firstCapacity < RESERVED);
+
+	// growth past the first commit keeps elements where they were
+	for (size_t i = 1; i < RESERVED; i++) {
+		array.push_back(static_cast<int>(i));
+	}
+	CHECK(array.size() == RESERVED);
+	CHECK(array.capacity() == RESERVED);
+	CHECK(&array[0] == firstAddress);
+	bool intact = true;
+	for (size_t i = 0; i < RESERVED; i++) {
+		intact = intact && array[i] == static_cast<int>(i);
+	}
+	CHECK(intact);
+
+	// the reservation is used up: nothing is committed past it
+	array.reserve(2 * RESERVED);
+	CHECK(array.capacity() == RESERVED);
+	bool threw = false;
+	try {
+		array.push_back(-1);
+	} catch (const std::bad_alloc&) {
+		threw = true;
+	}
+	CHECK(threw);
+	CHECK(array.size() == RESERVED);
+	CHECK(array.capacity() == RESERVED);
+
+	// decommitting gives the pages back and growth works again afterwards
+	while (array.size() > 1) {
+		array.pop_back();
+	}
+	CHECK(array.Decommit(0) > 0);
+	CHECK(array.capacity() == firstCapacity);
+	array.push_back(1);
+	CHECK(array.size() == 2 && array[1] == 1);
+
+	// an array without a reservation cannot grow at all
+	VirtualArray<int> unreserved;
+	threw = false;
+	try {
+		unreserved.push_back(0);
+	} catch (const std::bad_alloc&) {
+		threw = true;
+	}
+	CHECK(threw);
+	CHECK(unreserved.capacity() == 0);
+
+	if (failures == 0) {
+		std::printf("virtual array: ok\n");
+	}
+	return failures == 0 ? 0 : 1;
+}
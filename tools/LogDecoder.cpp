@@ -0,0 +1,232 @@
+// Renders a binary log written by BinaryLog (see Logger/BinaryLog.h) as text:
+//
+//   logdecoder session.plog [--sources]
+//
+// One line per event, in file order. --sources appends the file:line of the
+// call site.
+
+#include "Logger/BinaryLog.h"
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Format {
+	bool defined = false;
+	uint8_t level = 0;
+	uint8_t category = 0;
+	uint32_t line = 0;
+	std::string file;
+	std::string text;
+};
+
+class Reader {
+private:
+	std::FILE* file;
+
+public:
+	explicit Reader(std::FILE* file) : file(file) {}
+
+	template <typename T>
+	bool Read(T& value) {
+		return std::fread(&value, sizeof(T), 1, file) == 1;
+	}
+
+	bool ReadString(std::string& value) {
+		uint16_t length;
+		if (!Read(length)) {
+			return false;
+		}
+		value.resize(length);
+		return length == 0 || std::fread(&value[0], 1, length, file) == length;
+	}
+
+	bool ReadBytes(std::vector<unsigned char>& bytes, size_t size) {
+		bytes.resize(size);
+		return size == 0 || std::fread(bytes.data(), 1, size, file) == size;
+	}
+};
+
+const char* LevelName(uint8_t level) {
+	static const char* names[] = { "TRC", "DBG", "LOG", "WRN", "ERR" };
+	return level < sizeof(names) / sizeof(names[0]) ? names[level] : "???";
+}
+
+const char* CategoryTag(uint8_t category) {
+	static const char* tags[] = { "", "[ECS] ", "[Render] ", "[Asset] ", "[Script] " };
+	return category < sizeof(tags) / sizeof(tags[0]) ? tags[category] : "[?] ";
+}
+
+// Appends the next argument of the payload, false when it is malformed
+bool AppendArgument(const std::vector<unsigned char>& payload, size_t& offset, std::string& output) {
+	if (offset >= payload.size()) {
+		return false;
+	}
+	const char type = static_cast<char>(payload[offset++]);
+	auto take = [&](void* value, size_t size) {
+		if (offset + size > payload.size()) {
+			return false;
+		}
+		std::memcpy(value, payload.data() + offset, size);
+		offset += size;
+		return true;
+	};
+
+	switch (type) {
+	case BinaryLogFormat::INT_ARGUMENT: {
+		int64_t value;
+		if (!take(&value, sizeof(value))) return false;
+		output += std::to_string(value);
+		return true;
+	}
+	case BinaryLogFormat::UINT_ARGUMENT: {
+		uint64_t value;
+		if (!take(&value, sizeof(value))) return false;
+		output += std::to_string(value);
+		return true;
+	}
+	case BinaryLogFormat::DOUBLE_ARGUMENT: {
+		double value;
+		if (!take(&value, sizeof(value))) return false;
+		char text[32];
+		std::snprintf(text, sizeof(text), "%g", value);
+		output += text;
+		return true;
+	}
+	case BinaryLogFormat::BOOL_ARGUMENT: {
+		uint8_t value;
+		if (!take(&value, sizeof(value))) return false;
+		output += value ? "true" : "false";
+		return true;
+	}
+	case BinaryLogFormat::STRING_ARGUMENT: {
+		uint16_t length;
+		if (!take(&length, sizeof(length)) || offset + length > payload.size()) return false;
+		output.append(reinterpret_cast<const char*>(payload.data() + offset), length);
+		offset += length;
+		return true;
+	}
+	}
+	return false;
+}
+
+// Each {} of the format takes the next argument, extra arguments are appended
+std::string Render(const std::string& format, const std::vector<unsigned char>& payload) {
+	std::string output;
+	size_t offset = 0;
+	for (size_t i = 0; i < format.size(); i++) {
+		if (format[i] == '{' && i + 1 < format.size() && format[i + 1] == '}') {
+			if (!AppendArgument(payload, offset, output)) {
+				output += "{?}";
+			}
+			i++;
+		} else {
+			output += format[i];
+		}
+	}
+	while (offset < payload.size()) {
+		output += ' ';
+		if (!AppendArgument(payload, offset, output)) {
+			output += "{?}";
+			break;
+		}
+	}
+	return output;
+}
+
+std::string TimeToString(int64_t nanoseconds) {
+	const std::time_t seconds = static_cast<std::time_t>(nanoseconds / 1000000000);
+	char dateTime[32];
+	std::strftime(dateTime, sizeof(dateTime), "%d-%b-%Y %H:%M:%S", std::localtime(&seconds));
+	char fraction[16];
+	std::snprintf(fraction, sizeof(fraction), ".%06lld", static_cast<long long>(nanoseconds % 1000000000 / 1000));
+	return std::string(dateTime) + fraction;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::cerr << "usage: " << argv[0] << " <binary log> [--sources]" << std::endl;
+		return 2;
+	}
+	const bool sources = argc > 2 && std::strcmp(argv[2], "--sources") == 0;
+
+	std::FILE* file = std::fopen(argv[1], "rb");
+	if (!file) {
+		std::cerr << "Cannot open " << argv[1] << std::endl;
+		return 1;
+	}
+	Reader reader(file);
+
+	char magic[sizeof(BinaryLogFormat::MAGIC)];
+	if (!reader.Read(magic) || std::memcmp(magic, BinaryLogFormat::MAGIC, sizeof(magic)) != 0) {
+		std::cerr << argv[1] << " is not a binary log" << std::endl;
+		std::fclose(file);
+		return 1;
+	}
+
+	std::vector<Format> formats;
+	std::vector<unsigned char> payload;
+	bool truncated = false;
+	for (int tag; (tag = std::fgetc(file)) != EOF;) {
+		uint32_t id;
+		if (!reader.Read(id)) {
+			truncated = true;
+			break;
+		}
+
+		if (tag == BinaryLogFormat::FORMAT_RECORD) {
+			// the engine hands out format ids in order and writes each one
+			// before its events, so a new id is always the next one
+			if (id > formats.size()) {
+				std::cerr << "Format id " << id << " after " << formats.size() << " formats, corrupt log" << std::endl;
+				std::fclose(file);
+				return 1;
+			}
+			if (id == formats.size()) {
+				formats.emplace_back();
+			}
+			auto& format = formats[id];
+			if (!reader.Read(format.level) || !reader.Read(format.category) || !reader.Read(format.line) ||
+				!reader.ReadString(format.file) || !reader.ReadString(format.text)) {
+				truncated = true;
+				break;
+			}
+			format.defined = true;
+		} else if (tag == BinaryLogFormat::EVENT_RECORD) {
+			int64_t time;
+			uint16_t size;
+			if (!reader.Read(time) || !reader.Read(size) || !reader.ReadBytes(payload, size)) {
+				truncated = true;
+				break;
+			}
+			if (id >= formats.size() || !formats[id].defined) {
+				std::cout << "???: [" << TimeToString(time) << "] event with unknown format " << id << '\n';
+				continue;
+			}
+			const auto& format = formats[id];
+			std::cout << LevelName(format.level) << ": [" << TimeToString(time) << "]" << CategoryTag(format.category)
+					  << Render(format.text, payload);
+			if (sources) {
+				std::cout << "  (" << format.file << ":" << format.line << ")";
+			}
+			std::cout << '\n';
+		} else {
+			std::cerr << "Unknown record '" << static_cast<char>(tag) << "', stopping" << std::endl;
+			std::fclose(file);
+			return 1;
+		}
+	}
+
+	std::fclose(file);
+	if (truncated) {
+		// the engine was killed mid-write, what came before is still good
+		std::cerr << "The log ends in a partial record" << std::endl;
+	}
+	return 0;
+}